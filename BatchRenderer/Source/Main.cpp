@@ -0,0 +1,379 @@
+/*
+  ==============================================================================
+
+    Offline batch renderer for SelfMult.
+
+    Runs every audio file it's given (or finds in the given folders) through its
+    own SelfMultAudioProcessor and writes the result as wav, one file per job on
+    a thread pool as big as the number of cores.
+
+    usage: SelfMultBatch --output folder [--threads 8] [--block 4096] [--precision 32|64]
+                         [--state file] [--preset 3] [--d 10] [--exp 1.5] [--vol 1]
+                         [--envelope auto|full|decimated] [--oversampling 1|2|4|8] file-or-folder ...
+
+    --state loads a state saved by the plugin (getStateInformation), --preset one
+    of the factory presets, --d/--exp/--vol/--oversampling override single
+    parameters after that.
+    --envelope full keeps the envelope at the full rate also above 100kHz.
+    The oversampling's latency is taken off, the output lines up with the input.
+
+    Wav and aiff inputs are read through a MemoryMappedAudioFormatReader, other
+    formats stream normally. Every job reads and processes one block while the
+    previous one is written out by a writer thread (the ThreadedWriter holds two
+    blocks, so the two overlap but neither can run ahead).
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "../../Source/PluginProcessor.h"
+
+//==============================================================================
+namespace
+{
+    struct Settings
+    {
+        juce::File outputFolder;
+        int blockSize = 4096;
+        bool doublePrecision = false;
+        juce::MemoryBlock state;
+        int preset = -1;
+        juce::NamedValueSet overrides;
+        SelfMultAudioProcessor::EnvelopeMode envelopeMode = SelfMultAudioProcessor::EnvelopeMode::automatic;
+    };
+
+    struct Job
+    {
+        juce::File input, output;
+    };
+
+    struct Result
+    {
+        bool ok = false;
+        juce::String error;
+        double audioSeconds = 0;
+        double renderSeconds = 0;
+    };
+
+    //the arguments after these are their values, everything else that isn't an option is an input
+    const juce::StringArray valueOptions { "--output", "--threads", "--block", "--precision", "--state", "--preset", "--d", "--exp", "--vol", "--envelope", "--oversampling" };
+
+    std::unique_ptr<juce::AudioFormatReader> createReader (juce::AudioFormatManager& formatManager, const juce::File& file)
+    {
+        if (auto* format = formatManager.findFormatForFileExtension (file.getFileExtension()))
+        {
+            std::unique_ptr<juce::MemoryMappedAudioFormatReader> mapped (format->createMemoryMappedReader (file));
+
+            //pages get read in as the processor reaches them
+            if (mapped != nullptr && mapped->mapEntireFile())
+                return mapped;
+        }
+
+        return std::unique_ptr<juce::AudioFormatReader> (formatManager.createReaderFor (file));
+    }
+
+    std::unique_ptr<juce::AudioFormatWriter> createWriter (const juce::File& file, const juce::AudioFormatReader& reader)
+    {
+        juce::WavAudioFormat wav;
+
+        //same bit depth as the input where wav has it, float stays float
+        int bitsPerSample = reader.usesFloatingPointData ? 32 : (int) reader.bitsPerSample;
+        if (! wav.getPossibleBitDepths().contains (bitsPerSample))
+            bitsPerSample = 24;
+
+        file.deleteFile();
+        auto stream = std::make_unique<juce::FileOutputStream> (file);
+        if (stream->failedToOpen())
+            return {};
+
+        std::unique_ptr<juce::AudioFormatWriter> writer (wav.createWriterFor (stream.get(), reader.sampleRate, reader.numChannels,
+                                                                              bitsPerSample, {}, 0));
+        if (writer != nullptr)
+            stream.release(); //the writer owns it now
+
+        return writer;
+    }
+
+    void setupProcessor (SelfMultAudioProcessor& processor, const Settings& settings, double sampleRate, int numChannels)
+    {
+        juce::AudioProcessor::BusesLayout layout;
+        layout.inputBuses.add (juce::AudioChannelSet::canonicalChannelSet (numChannels));
+        layout.outputBuses.add (juce::AudioChannelSet::canonicalChannelSet (numChannels));
+        processor.setBusesLayout (layout);
+
+        if (! settings.state.isEmpty())
+            processor.setStateInformation (settings.state.getData(), (int) settings.state.getSize());
+
+        if (settings.preset >= 0)
+            processor.setCurrentProgram (settings.preset);
+
+        for (auto& value : settings.overrides)
+        {
+            auto* parameter = processor.parameters.getParameter (value.name.toString());
+            parameter->setValueNotifyingHost (parameter->convertTo0to1 ((float) value.value));
+        }
+
+        processor.setNonRealtime (true);
+        processor.setEnvelopeMode (settings.envelopeMode);
+        processor.setProcessingPrecision (settings.doublePrecision ? juce::AudioProcessor::doublePrecision
+                                                                   : juce::AudioProcessor::singlePrecision);
+        processor.setRateAndBufferSizeDetails (sampleRate, settings.blockSize);
+        processor.prepareToPlay (sampleRate, settings.blockSize);
+    }
+
+    template <typename SampleType>
+    Result renderFile (const Job& job, const Settings& settings, juce::AudioFormatManager& formatManager, juce::TimeSliceThread& writerThread)
+    {
+        Result result;
+        const auto start = juce::Time::getHighResolutionTicks();
+
+        auto reader = createReader (formatManager, job.input);
+        if (reader == nullptr || reader->lengthInSamples <= 0)
+            return { false, "can't read" };
+
+        const int numChannels = (int) reader->numChannels;
+        if (numChannels < 1 || numChannels > 64)
+            return { false, "unsupported channel count " + juce::String (numChannels) };
+
+        job.output.getParentDirectory().createDirectory();
+        auto writer = createWriter (job.output, *reader);
+        if (writer == nullptr)
+            return { false, "can't write " + job.output.getFullPathName() };
+
+        //two blocks: this job fills the next one while the writer thread writes out the last
+        juce::AudioFormatWriter::ThreadedWriter threadedWriter (writer.release(), writerThread, 2 * settings.blockSize);
+
+        SelfMultAudioProcessor processor;
+        setupProcessor (processor, settings, reader->sampleRate, numChannels);
+
+        juce::AudioBuffer<float> block (numChannels, settings.blockSize);
+        //the file is read and written as float, double precision only runs the processor in double
+        juce::AudioBuffer<double> doubleBlock (std::is_same<SampleType, double>::value ? numChannels : 0, settings.blockSize);
+        juce::MidiBuffer midi;
+
+        //the output is late by the processor's latency, that much gets cut from the start and rendered past the end
+        const int latency = processor.getLatencySamples();
+        const juce::int64 totalSamples = reader->lengthInSamples + latency;
+        const float* writePointers[64] = {};
+
+        for (juce::int64 pos = 0; pos < totalSamples; pos += settings.blockSize)
+        {
+            const int numSamples = (int) juce::jmin ((juce::int64) settings.blockSize, totalSamples - pos);
+
+            reader->read (&block, 0, numSamples, pos, true, true); //zeros past the end
+
+            if constexpr (std::is_same<SampleType, double>::value)
+            {
+                juce::AudioBuffer<double> view (doubleBlock.getArrayOfWritePointers(), numChannels, numSamples);
+                for (int channel = 0; channel < numChannels; ++channel)
+                    for (int i = 0; i < numSamples; ++i)
+                        view.setSample (channel, i, block.getSample (channel, i));
+
+                processor.processBlock (view, midi);
+
+                for (int channel = 0; channel < numChannels; ++channel)
+                    for (int i = 0; i < numSamples; ++i)
+                        block.setSample (channel, i, (float) view.getSample (channel, i));
+            }
+            else
+            {
+                juce::AudioBuffer<float> view (block.getArrayOfWritePointers(), numChannels, numSamples);
+                processor.processBlock (view, midi);
+            }
+
+            const int skip = (int) juce::jlimit ((juce::int64) 0, (juce::int64) numSamples, latency - pos);
+            if (skip == numSamples)
+                continue;
+
+            for (int channel = 0; channel < numChannels; ++channel)
+                writePointers[channel] = block.getReadPointer (channel, skip);
+
+            //only fails while the writer is still busy with the block before
+            while (! threadedWriter.write (writePointers, numSamples - skip))
+                juce::Thread::sleep (1);
+        }
+
+        processor.releaseResources();
+
+        result.ok = true;
+        result.audioSeconds = (double) reader->lengthInSamples / reader->sampleRate;
+        result.renderSeconds = juce::Time::highResolutionTicksToSeconds (juce::Time::getHighResolutionTicks() - start);
+        return result;
+    }
+
+    juce::Array<Job> collectJobs (const juce::ArgumentList& args, const juce::File& outputFolder, const juce::AudioFormatManager& formatManager)
+    {
+        juce::Array<Job> jobs;
+        const auto wildcard = formatManager.getWildcardForAllFormats();
+
+        for (int i = 0; i < args.size(); ++i)
+        {
+            const auto& arg = args[i];
+            if (arg.isOption())
+            {
+                if (valueOptions.contains (arg.text))
+                    ++i;
+                continue;
+            }
+
+            const auto input = arg.resolveAsFile();
+
+            //files from folders keep their relative path inside the output folder
+            if (input.isDirectory())
+            {
+                for (auto& file : input.findChildFiles (juce::File::findFiles, true, wildcard))
+                    jobs.add ({ file, outputFolder.getChildFile (file.getRelativePathFrom (input)).withFileExtension ("wav") });
+            }
+            else
+            {
+                jobs.add ({ input, outputFolder.getChildFile (input.getFileNameWithoutExtension() + ".wav") });
+            }
+        }
+
+        return jobs;
+    }
+}
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+    juce::ArgumentList args (argc, argv);
+
+    if (! args.containsOption ("--output"))
+    {
+        std::cerr << "usage: SelfMultBatch --output folder [--threads n] [--block n] [--precision 32|64]" << std::endl
+                  << "                     [--state file] [--preset n] [--d ms] [--exp x] [--vol x]" << std::endl
+                  << "                     [--envelope auto|full|decimated] [--oversampling 1|2|4|8] file-or-folder ..." << std::endl;
+        return 1;
+    }
+
+    Settings settings;
+    settings.outputFolder = juce::File::getCurrentWorkingDirectory().getChildFile (args.getValueForOption ("--output"));
+    settings.outputFolder.createDirectory();
+
+    if (args.containsOption ("--block"))
+        settings.blockSize = juce::jlimit (32, 65536, args.getValueForOption ("--block").getIntValue());
+
+    settings.doublePrecision = args.getValueForOption ("--precision").getIntValue() == 64;
+
+    if (args.containsOption ("--state"))
+    {
+        const auto stateFile = juce::File::getCurrentWorkingDirectory().getChildFile (args.getValueForOption ("--state"));
+        if (! stateFile.loadFileAsData (settings.state))
+        {
+            std::cerr << "could not read " << stateFile.getFullPathName() << std::endl;
+            return 1;
+        }
+    }
+
+    if (args.containsOption ("--envelope"))
+    {
+        const auto mode = args.getValueForOption ("--envelope");
+        settings.envelopeMode = mode == "full" ? SelfMultAudioProcessor::EnvelopeMode::fullRate
+                              : mode == "decimated" ? SelfMultAudioProcessor::EnvelopeMode::decimated
+                                                    : SelfMultAudioProcessor::EnvelopeMode::automatic;
+    }
+
+    if (args.containsOption ("--preset"))
+        settings.preset = args.getValueForOption ("--preset").getIntValue();
+
+    const std::pair<const char*, const char*> overrides[] = { { "--d", SelfMultAudioProcessor::delayId },
+                                                              { "--exp", SelfMultAudioProcessor::exponentId },
+                                                              { "--vol", SelfMultAudioProcessor::userVolId } };
+    for (auto& o : overrides)
+        if (args.containsOption (o.first))
+            settings.overrides.set (o.second, args.getValueForOption (o.first).getFloatValue());
+
+    //the parameter is the index of 1x, 2x, 4x, 8x
+    if (args.containsOption ("--oversampling"))
+    {
+        const int factor = juce::jlimit (1, 8, juce::nextPowerOfTwo (args.getValueForOption ("--oversampling").getIntValue()));
+        settings.overrides.set (SelfMultAudioProcessor::oversamplingId, juce::findHighestSetBit ((juce::uint32) factor));
+    }
+
+    juce::AudioFormatManager formatManager;
+    formatManager.registerBasicFormats();
+
+    const auto jobs = collectJobs (args, settings.outputFolder, formatManager);
+    if (jobs.isEmpty())
+    {
+        std::cerr << "no input files" << std::endl;
+        return 1;
+    }
+
+    for (auto& job : jobs)
+    {
+        if (job.output == job.input)
+        {
+            std::cerr << "output would overwrite " << job.input.getFullPathName() << std::endl;
+            return 1;
+        }
+    }
+
+    const int numThreads = args.containsOption ("--threads") ? juce::jmax (1, args.getValueForOption ("--threads").getIntValue())
+                                                             : juce::SystemStats::getNumCpus();
+
+    //encoding is cheap next to the dsp, one writer thread for every four workers is plenty
+    juce::OwnedArray<juce::TimeSliceThread> writerThreads;
+    for (int i = 0; i < juce::jmax (1, numThreads / 4); ++i)
+        writerThreads.add (new juce::TimeSliceThread ("SelfMult writer " + juce::String (i)))->startThread();
+
+    std::vector<Result> results ((size_t) jobs.size());
+    juce::CriticalSection printLock;
+    int numDone = 0;
+
+    const auto start = juce::Time::getHighResolutionTicks();
+
+    {
+        juce::ThreadPool pool (numThreads);
+
+        for (int i = 0; i < jobs.size(); ++i)
+        {
+            pool.addJob ([&, i]
+            {
+                auto& writerThread = *writerThreads[i % writerThreads.size()];
+                auto result = settings.doublePrecision ? renderFile<double> (jobs[i], settings, formatManager, writerThread)
+                                                       : renderFile<float> (jobs[i], settings, formatManager, writerThread);
+
+                const juce::ScopedLock lock (printLock);
+                results[(size_t) i] = result;
+                ++numDone;
+
+                if (result.ok)
+                    std::cout << "[" << numDone << "/" << jobs.size() << "] " << jobs[i].input.getFileName() << ": "
+                              << juce::String (result.audioSeconds / result.renderSeconds, 1) << "x realtime" << std::endl;
+                else
+                    std::cerr << "[" << numDone << "/" << jobs.size() << "] " << jobs[i].input.getFullPathName() << ": " << result.error << std::endl;
+            });
+        }
+
+        //the pool's destructor would cancel what's still queued
+        while (pool.getNumJobs() > 0)
+            juce::Thread::sleep (50);
+    }
+
+    //writers flush what's left when their job ends, so everything is on disk by now
+    const double wallSeconds = juce::Time::highResolutionTicksToSeconds (juce::Time::getHighResolutionTicks() - start);
+    writerThreads.clear();
+
+    double audioSeconds = 0, renderSeconds = 0;
+    int numFailed = 0;
+    for (auto& result : results)
+    {
+        audioSeconds += result.audioSeconds;
+        renderSeconds += result.renderSeconds;
+        numFailed += result.ok ? 0 : 1;
+    }
+
+    //per thread is what one core does, overall what the whole batch got with all of them
+    std::cout << jobs.size() - numFailed << " files, " << juce::String (audioSeconds, 1) << "s of audio in "
+              << juce::String (wallSeconds, 2) << "s with " << numThreads << " threads: "
+              << juce::String (audioSeconds / wallSeconds, 1) << "x realtime overall, "
+              << juce::String (renderSeconds > 0 ? audioSeconds / renderSeconds : 0.0, 1) << "x per thread" << std::endl;
+
+    if (numFailed > 0)
+        std::cerr << numFailed << " files failed" << std::endl;
+
+    return numFailed > 0 ? 1 : 0;
+}
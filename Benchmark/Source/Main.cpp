@@ -0,0 +1,604 @@
+/*
+  ==============================================================================
+
+    Headless benchmark for SelfMultAudioProcessor.
+
+    Runs the processor over a matrix of sample rates, block sizes, channel counts
+    and d/exp settings and prints the results as JSON.
+
+    usage: SelfMultBenchmark [--rates 44100,48000] [--blocks 64,512] [--channels 1,2]
+                             [--delays 0,10,50] [--exps 0.5,1,2] [--interps 0,1,2] [--seconds 2]
+                             [--file input.wav] [--reference] [--output results.json]
+                             [--random-blocks] [--precisions 32,64] [--metering] [--envelopes 0,1,2]
+                             [--instances 100] [--oversampling 1,2,4,8] [--check-soft-attack]
+
+    --precisions 64 runs the processor in double precision, with double blocks
+    copied from the same signal.
+    --metering runs with the editor's metering on (nobody reads the fifo, so it's
+    full most of the time), to see what it costs on the audio thread.
+    --envelopes picks the envelope mode: 0 automatic, 1 full rate, 2 decimated.
+    --oversampling runs the multiply stage at 1, 2, 4 or 8 times the rate, the
+    results have the latency that adds.
+
+    --random-blocks feeds the processor random block sizes from 1 to 8192 (after
+    preparing it for 512) and checks the output against fixed 512 sample blocks,
+    and that nothing allocated or locked inside processBlock.
+
+    --check-soft-attack runs the soft attack trigger with the SlidingMaxTracker the
+    kernel uses next to the window rescan it replaced, on transient material (or
+    --file), and fails if any trigger decision differs.
+
+    --instances creates and prepares that many processors side by side, once with
+    the tables shared between them and once with every instance building its own,
+    and reports the time and memory per instance.
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "../../Source/PluginProcessor.h"
+
+//==============================================================================
+namespace
+{
+    template <typename Type>
+    juce::Array<Type> parseList (const juce::ArgumentList& args, const juce::String& option, juce::Array<Type> defaults)
+    {
+        if (! args.containsOption (option))
+            return defaults;
+
+        juce::Array<Type> values;
+        for (auto& token : juce::StringArray::fromTokens (args.getValueForOption (option), ",", {}))
+            values.add (static_cast<Type> (token.trim().getDoubleValue()));
+
+        return values;
+    }
+
+    // sweeping sines with noise and short bursts, so the soft attack gets triggered regularly
+    void fillSynthetic (juce::AudioBuffer<float>& signal, double sampleRate)
+    {
+        juce::Random random (1234);
+
+        for (int channel = 0; channel < signal.getNumChannels(); ++channel)
+        {
+            auto* data = signal.getWritePointer (channel);
+            double phase = 0.1 * channel;
+
+            for (int i = 0; i < signal.getNumSamples(); ++i)
+            {
+                const double t = i / sampleRate;
+                const double frequency = 80.0 + 1000.0 * (0.5 + 0.5 * std::sin (juce::MathConstants<double>::twoPi * 0.25 * t));
+                phase += juce::MathConstants<double>::twoPi * frequency / sampleRate;
+
+                //a loud burst every 250ms, decaying over 30ms
+                const double sinceBurst = std::fmod (t, 0.25);
+                const double burst = sinceBurst < 0.03 ? 4.0 * (1.0 - sinceBurst / 0.03) : 1.0;
+
+                data[i] = static_cast<float> (0.2 * burst * std::sin (phase) + 0.01 * (random.nextFloat() * 2.0f - 1.0f));
+            }
+        }
+    }
+
+    // clicks, hits decaying at random speeds, steps and silence in between, on a bit of noise.
+    // lots of rises that are the biggest in the window, and lots of those leaving it again
+    void fillTransients (juce::AudioBuffer<float>& signal)
+    {
+        juce::Random random (4321);
+
+        for (int channel = 0; channel < signal.getNumChannels(); ++channel)
+        {
+            auto* data = signal.getWritePointer (channel);
+            float level = 0, decay = 0.99f, dc = 0;
+
+            for (int i = 0; i < signal.getNumSamples(); ++i)
+            {
+                switch (random.nextInt (2000))
+                {
+                    case 0:  level = random.nextFloat(); decay = 0.9f + 0.0999f * random.nextFloat(); break;
+                    case 1:  data[i] = random.nextFloat() * 2.0f - 1.0f; continue; //click
+                    case 2:  dc = random.nextBool() ? 0.0f : 0.5f * random.nextFloat(); break;
+                    default: break;
+                }
+
+                level *= decay;
+                data[i] = dc + level * (random.nextFloat() * 2.0f - 1.0f) + 0.001f * (random.nextFloat() * 2.0f - 1.0f);
+            }
+        }
+    }
+
+    // loops the file (ignoring its own sample rate) until the signal buffer is full
+    bool fillFromFile (juce::AudioBuffer<float>& signal, const juce::File& file)
+    {
+        juce::AudioFormatManager formatManager;
+        formatManager.registerBasicFormats();
+
+        std::unique_ptr<juce::AudioFormatReader> reader (formatManager.createReaderFor (file));
+        if (reader == nullptr || reader->lengthInSamples <= 0)
+            return false;
+
+        juce::AudioBuffer<float> fileData ((int) reader->numChannels, (int) reader->lengthInSamples);
+        reader->read (&fileData, 0, fileData.getNumSamples(), 0, true, true);
+
+        for (int channel = 0; channel < signal.getNumChannels(); ++channel)
+        {
+            const int sourceChannel = channel % fileData.getNumChannels();
+            for (int pos = 0; pos < signal.getNumSamples(); pos += fileData.getNumSamples())
+            {
+                const int num = juce::jmin (fileData.getNumSamples(), signal.getNumSamples() - pos);
+                signal.copyFrom (channel, pos, fileData, sourceChannel, 0, num);
+            }
+        }
+
+        return true;
+    }
+
+    void setParameter (SelfMultAudioProcessor& processor, const char* parameterId, float value)
+    {
+        auto* parameter = processor.parameters.getParameter (parameterId);
+        parameter->setValueNotifyingHost (parameter->convertTo0to1 (value));
+    }
+
+    // estimated memory traffic per channel sample that doesn't come from L1 (taken as 32 KB), for the fused
+    // path the processor runs and the unfused one it replaced, to compare them per block size.
+    // fused: a group of channels goes through all stages one sub-block at a time, the host block of the group
+    // plus its scratch (window sums, soft attack factors, one delayed channel) is the working set, so the host
+    // buffer is read and written once and the 9 scratch accesses per sample hit L1.
+    // unfused: three sweeps over the whole block of every channel (delay write, rms gain, delay read + multiply)
+    // with a gain and a delayed buffer per channel, once that doesn't fit in L1 all 4 host buffer accesses and
+    // all 4 scratch accesses per sample miss. the delay line's own ring is the same for both and left out
+    struct MemoryTraffic
+    {
+        juce::int64 workingSetBytes;
+        int streamedBytesPerSample;
+    };
+
+    MemoryTraffic estimateMemoryTraffic (int blockSize, int numChannels, int sampleSize, bool fused)
+    {
+        constexpr juce::int64 l1Bytes = 32 * 1024;
+
+        if (fused)
+        {
+            const juce::int64 subBlock = juce::jmin (blockSize, SelfMultAudioProcessor::maxSubBlockSize);
+            const juce::int64 groupSize = juce::jmin (numChannels, (int) SelfMultKernel<SelfMultMode::A>::maxGroupSize);
+            const juce::int64 workingSet = (groupSize * subBlock * 3 + subBlock) * sampleSize;
+            return { workingSet, (workingSet <= l1Bytes ? 2 : 2 + 9) * sampleSize };
+        }
+
+        const juce::int64 workingSet = (juce::int64) numChannels * blockSize * 3 * sampleSize;
+        return { workingSet, (workingSet <= l1Bytes ? 2 : 4 + 4) * sampleSize };
+    }
+
+    struct Config
+    {
+        double sampleRate;
+        int blockSize;
+        int numChannels;
+        float delay;
+        float exponent;
+        int interpolation;
+        int envelope;
+        int oversampling;
+    };
+
+    template <typename SampleType>
+    juce::var runConfig (const Config& config, const juce::AudioBuffer<SampleType>& signal, bool useReference, bool metering)
+    {
+        SelfMultAudioProcessor processor;
+
+        juce::AudioProcessor::BusesLayout layout;
+        layout.inputBuses.add (juce::AudioChannelSet::canonicalChannelSet (config.numChannels));
+        layout.outputBuses.add (juce::AudioChannelSet::canonicalChannelSet (config.numChannels));
+        if (! processor.setBusesLayout (layout))
+            return {};
+
+        processor.setUseReferenceKernel (useReference);
+        processor.setMeteringEnabled (metering);
+        processor.setEnvelopeMode (static_cast<SelfMultAudioProcessor::EnvelopeMode> (config.envelope));
+        setParameter (processor, SelfMultAudioProcessor::delayId, config.delay);
+        setParameter (processor, SelfMultAudioProcessor::exponentId, config.exponent);
+        setParameter (processor, SelfMultAudioProcessor::interpolationId, (float) config.interpolation);
+        setParameter (processor, SelfMultAudioProcessor::oversamplingId, (float) juce::findHighestSetBit ((juce::uint32) config.oversampling));
+
+        if (std::is_same<SampleType, double>::value)
+            processor.setProcessingPrecision (juce::AudioProcessor::doublePrecision);
+
+        processor.setRateAndBufferSizeDetails (config.sampleRate, config.blockSize);
+        processor.prepareToPlay (config.sampleRate, config.blockSize);
+
+        juce::AudioBuffer<SampleType> block (config.numChannels, config.blockSize);
+        juce::MidiBuffer midi;
+
+        const int numSamples = signal.getNumSamples();
+        juce::int64 ticks = 0;
+
+        //one pass to warm up caches and fill the delay and rms buffers, then the measured pass
+        for (int pass = 0; pass < 2; ++pass)
+        {
+           #if SELFMULT_STAGE_TIMINGS
+            processor.getStageTimings().reset();
+            processor.getProfiler().reset();
+           #endif
+            ticks = 0;
+
+            for (int pos = 0; pos + config.blockSize <= numSamples; pos += config.blockSize)
+            {
+                for (int channel = 0; channel < config.numChannels; ++channel)
+                    block.copyFrom (channel, 0, signal, channel, pos, config.blockSize);
+
+                const auto start = juce::Time::getHighResolutionTicks();
+                processor.processBlock (block, midi);
+                ticks += juce::Time::getHighResolutionTicks() - start;
+            }
+        }
+
+        const int processed = numSamples - numSamples % config.blockSize;
+        const double seconds = juce::Time::highResolutionTicksToSeconds (ticks);
+        const double nsPerSample = seconds * 1.0e9 / processed;
+
+        auto* result = new juce::DynamicObject();
+        result->setProperty ("sampleRate", config.sampleRate);
+        result->setProperty ("blockSize", config.blockSize);
+        result->setProperty ("channels", config.numChannels);
+        result->setProperty ("delay", config.delay);
+        result->setProperty ("exp", config.exponent);
+        result->setProperty ("interpolation", config.interpolation);
+        result->setProperty ("envelope", config.envelope);
+        result->setProperty ("envelopeDecimation", processor.getEnvelopeDecimation());
+        result->setProperty ("oversampling", processor.getOversamplingFactor());
+        result->setProperty ("latency", processor.getLatencySamples());
+        result->setProperty ("precision", (int) sizeof (SampleType) * 8);
+        result->setProperty ("metering", metering);
+        result->setProperty ("nsPerSample", nsPerSample);
+        result->setProperty ("nsPerChannelSample", nsPerSample / config.numChannels);
+        result->setProperty ("realtimeFactor", (processed / config.sampleRate) / seconds);
+        result->setProperty ("memoryBytes", (juce::int64) processor.getMemoryFootprint());
+
+        for (const bool fused : { true, false })
+        {
+            const auto traffic = estimateMemoryTraffic (config.blockSize, config.numChannels, (int) sizeof (SampleType), fused);
+            auto* estimate = new juce::DynamicObject();
+            estimate->setProperty ("workingSetBytes", traffic.workingSetBytes);
+            estimate->setProperty ("streamedBytesPerSample", traffic.streamedBytesPerSample);
+            estimate->setProperty ("streamedBytesPerBlock", (juce::int64) traffic.streamedBytesPerSample * config.blockSize * config.numChannels);
+            result->setProperty (fused ? "memoryTraffic" : "unfusedMemoryTraffic", juce::var (estimate));
+        }
+
+       #if SELFMULT_STAGE_TIMINGS
+        auto* stages = new juce::DynamicObject();
+        for (int stage = 0; stage < StageTimings::numStages; ++stage)
+            stages->setProperty (StageTimings::getStageName (stage), processor.getStageTimings().getSeconds (stage) * 1.0e9 / processed);
+
+        result->setProperty ("stagesNsPerSample", juce::var (stages));
+
+        //worst blocks rather than the average, from the profiler's histograms (power of two resolution)
+        auto* p99 = new juce::DynamicObject();
+        for (int histogram = 0; histogram < StageProfiler::numHistograms; ++histogram)
+            p99->setProperty (StageProfiler::getHistogramName (histogram), (juce::int64) processor.getProfiler().getPercentileNs (histogram, 0.99));
+
+        result->setProperty ("p99NsPerBlock", juce::var (p99));
+       #endif
+
+        processor.releaseResources();
+        return juce::var (result);
+    }
+
+    juce::var runRandomBlockCheck (double sampleRate, const juce::AudioBuffer<float>& signal)
+    {
+        const int numChannels = signal.getNumChannels();
+        const int numSamples = signal.getNumSamples();
+        const int preparedBlockSize = 512;
+
+        auto process = [&] (juce::AudioBuffer<float>& output, bool randomBlocks)
+        {
+            SelfMultAudioProcessor processor;
+
+            juce::AudioProcessor::BusesLayout layout;
+            layout.inputBuses.add (juce::AudioChannelSet::canonicalChannelSet (numChannels));
+            layout.outputBuses.add (juce::AudioChannelSet::canonicalChannelSet (numChannels));
+            processor.setBusesLayout (layout);
+
+            setParameter (processor, SelfMultAudioProcessor::delayId, 10.0f);
+            setParameter (processor, SelfMultAudioProcessor::exponentId, 1.7f);
+
+            processor.setRateAndBufferSizeDetails (sampleRate, preparedBlockSize);
+            processor.prepareToPlay (sampleRate, preparedBlockSize);
+
+            output.makeCopyOf (signal);
+            juce::Random random (42);
+            juce::MidiBuffer midi;
+            int numBlocks = 0;
+
+            for (int pos = 0; pos < numSamples; ++numBlocks)
+            {
+                const int blockSize = juce::jmin (randomBlocks ? 1 + random.nextInt (8192) : preparedBlockSize, numSamples - pos);
+                juce::AudioBuffer<float> block (output.getArrayOfWritePointers(), numChannels, pos, blockSize);
+                processor.processBlock (block, midi);
+                pos += blockSize;
+            }
+
+            processor.releaseResources();
+            return numBlocks;
+        };
+
+        juce::AudioBuffer<float> fixedOutput, randomOutput;
+        process (fixedOutput, false);
+        const int violationsBefore = RealtimeCheck::getNumViolations();
+        const int numBlocks = process (randomOutput, true);
+
+        float maxDifference = 0;
+        for (int channel = 0; channel < numChannels; ++channel)
+            for (int i = 0; i < numSamples; ++i)
+                maxDifference = juce::jmax (maxDifference, std::abs (fixedOutput.getSample (channel, i) - randomOutput.getSample (channel, i)));
+
+        auto* result = new juce::DynamicObject();
+        result->setProperty ("sampleRate", sampleRate);
+        result->setProperty ("channels", numChannels);
+        result->setProperty ("blocks", numBlocks);
+        result->setProperty ("maxDifference", maxDifference);
+        result->setProperty ("peak", fixedOutput.getMagnitude (0, numSamples));
+        result->setProperty ("realtimeChecks", SELFMULT_REALTIME_CHECKS != 0);
+        result->setProperty ("realtimeViolations", RealtimeCheck::getNumViolations() - violationsBefore);
+        return juce::var (result);
+    }
+
+    // the kernel's checkSoftAttackTrigger, with where the new max rise comes from left to the caller
+    struct SoftAttackTrigger
+    {
+        float maxRise = 0;
+        int maxRiseIndex = 0;
+
+        template <typename FindMaxRise>
+        bool check (float rise, int index, FindMaxRise&& findMaxRise)
+        {
+            if (index == maxRiseIndex)
+                maxRise = findMaxRise();
+
+            const bool triggered = maxRise * 1.5 < rise;
+
+            if (maxRise < rise)
+            {
+                maxRise = rise;
+                maxRiseIndex = index;
+            }
+
+            return triggered;
+        }
+    };
+
+    // the soft attack trigger as the kernel runs it (full rate envelope), once with the tracker and once with the
+    // window rescan from before it. both see the same rises and the same soft attack state, so every decision
+    // (trigger or not, and the max rise it compared against) has to be identical
+    juce::var runSoftAttackCheck (double sampleRate, const juce::AudioBuffer<float>& signal)
+    {
+        const int windowLength = (int) std::ceil (1.0 / 60 * sampleRate);
+        const int numSamples = signal.getNumSamples();
+
+        juce::int64 numTriggers = 0, numMismatches = 0, firstMismatch = -1;
+
+        for (int channel = 0; channel < signal.getNumChannels(); ++channel)
+        {
+            const auto* data = signal.getReadPointer (channel);
+            std::vector<float> squares ((size_t) windowLength, 0.0f);
+            SlidingMaxTracker<float> tracker;
+            tracker.prepare (windowLength - 2);
+            SoftAttackTrigger withTracker, withRescan;
+            bool inProgress = false;
+            int progress = 0;
+
+            for (int i = 0, index = 0; i < numSamples; ++i)
+            {
+                squares[(size_t) index] = data[i] * data[i];
+                const int lastIndex = index == 0 ? windowLength - 1 : index - 1;
+                const float rise = squares[(size_t) index] - squares[(size_t) lastIndex];
+
+                if (! inProgress)
+                {
+                    const bool fromTracker = withTracker.check (rise, index, [&] { return tracker.getMax(); });
+                    const bool fromRescan = withRescan.check (rise, index, [&]
+                    {
+                        //every rise in the window except the newest and the oldest, both involve the new sample
+                        float maxRise = 0;
+                        for (int k = 0, last = windowLength - 1; k < windowLength; last = k++)
+                            if (k != index && last != index)
+                                maxRise = juce::jmax (maxRise, squares[(size_t) k] - squares[(size_t) last]);
+                        return maxRise;
+                    });
+
+                    if (fromTracker != fromRescan || withTracker.maxRise != withRescan.maxRise)
+                    {
+                        if (numMismatches++ == 0)
+                            firstMismatch = (juce::int64) channel * numSamples + i;
+                    }
+
+                    //the rms threshold doesn't matter here, both would see the same sum
+                    if (fromRescan)
+                    {
+                        ++numTriggers;
+                        inProgress = true;
+                        progress = 0;
+                    }
+                }
+
+                tracker.push (rise);
+
+                //a soft attack lasts as long as the kernel's
+                if (inProgress && progress++ >= windowLength - 1)
+                    inProgress = false;
+
+                if (++index >= windowLength)
+                    index = 0;
+            }
+        }
+
+        auto* result = new juce::DynamicObject();
+        result->setProperty ("check", "softAttackTracker");
+        result->setProperty ("sampleRate", sampleRate);
+        result->setProperty ("windowLength", windowLength);
+        result->setProperty ("samples", (juce::int64) numSamples * signal.getNumChannels());
+        result->setProperty ("triggers", numTriggers);
+        result->setProperty ("mismatches", numMismatches);
+        result->setProperty ("firstMismatch", firstMismatch);
+        return juce::var (result);
+    }
+
+    juce::var runInstances (double sampleRate, int numChannels, int numInstances, bool shareTables)
+    {
+        juce::OwnedArray<SelfMultAudioProcessor> processors;
+        size_t bytes = 0;
+
+        const auto start = juce::Time::getHighResolutionTicks();
+
+        for (int i = 0; i < numInstances; ++i)
+        {
+            auto* processor = processors.add (new SelfMultAudioProcessor());
+
+            juce::AudioProcessor::BusesLayout layout;
+            layout.inputBuses.add (juce::AudioChannelSet::canonicalChannelSet (numChannels));
+            layout.outputBuses.add (juce::AudioChannelSet::canonicalChannelSet (numChannels));
+            processor->setBusesLayout (layout);
+            processor->setShareTables (shareTables);
+
+            processor->setRateAndBufferSizeDetails (sampleRate, 512);
+            processor->prepareToPlay (sampleRate, 512);
+        }
+
+        const double seconds = juce::Time::highResolutionTicksToSeconds (juce::Time::getHighResolutionTicks() - start);
+
+        for (auto* processor : processors)
+            bytes += processor->getMemoryFootprint();
+
+        //counted once, whichever instance asks
+        bytes += processors.getFirst()->getSharedTableMemory();
+
+        auto* result = new juce::DynamicObject();
+        result->setProperty ("sampleRate", sampleRate);
+        result->setProperty ("channels", numChannels);
+        result->setProperty ("instances", numInstances);
+        result->setProperty ("sharedTables", shareTables);
+        result->setProperty ("msPerInstance", seconds * 1000.0 / numInstances);
+        result->setProperty ("bytesPerInstance", (juce::int64) (bytes / (size_t) numInstances));
+        return juce::var (result);
+    }
+}
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+    juce::ArgumentList args (argc, argv);
+
+    const auto rates     = parseList<double> (args, "--rates",    { 44100.0, 48000.0, 96000.0, 192000.0 });
+    const auto blocks    = parseList<int>    (args, "--blocks",   { 32, 128, 512, 2048 });
+    const auto channels  = parseList<int>    (args, "--channels", { 1, 2 });
+    const auto delays    = parseList<float>  (args, "--delays",   { 0.0f, 10.0f, 50.0f });
+    const auto exponents = parseList<float>  (args, "--exps",     { 0.0f, 0.5f, 1.0f, 2.0f, 3.0f });
+    const auto interps   = parseList<int>    (args, "--interps",  { 0 });
+    const auto precisions = parseList<int>   (args, "--precisions", { 32 });
+    const auto envelopes = parseList<int>    (args, "--envelopes", { 0 });
+    const auto oversampling = parseList<int> (args, "--oversampling", { 1 });
+
+    const double seconds = args.containsOption ("--seconds") ? args.getValueForOption ("--seconds").getDoubleValue() : 2.0;
+    const bool useReference = args.containsOption ("--reference");
+    const bool randomBlocks = args.containsOption ("--random-blocks");
+    const bool checkSoftAttack = args.containsOption ("--check-soft-attack");
+    const bool metering = args.containsOption ("--metering");
+    const int numInstances = args.containsOption ("--instances") ? juce::jmax (1, args.getValueForOption ("--instances").getIntValue()) : 0;
+    bool failed = false;
+
+    juce::File inputFile;
+    if (args.containsOption ("--file"))
+    {
+        inputFile = juce::File::getCurrentWorkingDirectory().getChildFile (args.getValueForOption ("--file"));
+        if (! inputFile.existsAsFile())
+        {
+            std::cerr << "file not found: " << inputFile.getFullPathName() << std::endl;
+            return 1;
+        }
+    }
+
+    juce::Array<juce::var> results;
+
+    for (auto sampleRate : rates)
+    {
+        for (auto numChannels : channels)
+        {
+            if (numInstances > 0)
+            {
+                results.add (runInstances (sampleRate, numChannels, numInstances, true));
+                results.add (runInstances (sampleRate, numChannels, numInstances, false));
+                continue;
+            }
+
+            juce::AudioBuffer<float> signal (numChannels, (int) (seconds * sampleRate));
+
+            if (inputFile.existsAsFile())
+            {
+                if (! fillFromFile (signal, inputFile))
+                {
+                    std::cerr << "could not read " << inputFile.getFullPathName() << std::endl;
+                    return 1;
+                }
+            }
+            else if (checkSoftAttack)
+            {
+                fillTransients (signal);
+            }
+            else
+            {
+                fillSynthetic (signal, sampleRate);
+            }
+
+            if (checkSoftAttack)
+            {
+                auto result = runSoftAttackCheck (sampleRate, signal);
+                failed = failed || (juce::int64) result["mismatches"] > 0;
+                results.add (result);
+                continue;
+            }
+
+            if (randomBlocks)
+            {
+                auto result = runRandomBlockCheck (sampleRate, signal);
+                failed = failed || (int) result["realtimeViolations"] > 0
+                                || (float) result["maxDifference"] > 1.0e-3f * (float) result["peak"];
+                results.add (result);
+                continue;
+            }
+
+            juce::AudioBuffer<double> doubleSignal;
+            if (precisions.contains (64))
+                doubleSignal.makeCopyOf (signal);
+
+            for (auto precision : precisions)
+                for (auto blockSize : blocks)
+                    for (auto delay : delays)
+                        for (auto exponent : exponents)
+                            for (auto interpolation : interps)
+                                for (auto envelope : envelopes)
+                                    for (auto factor : oversampling)
+                                    {
+                                        const Config config { sampleRate, blockSize, numChannels, delay, exponent, interpolation,
+                                                              juce::jlimit (0, 2, envelope), juce::jlimit (1, 8, juce::nextPowerOfTwo (factor)) };
+                                        auto result = precision == 64 ? runConfig (config, doubleSignal, useReference, metering)
+                                                                      : runConfig (config, signal, useReference, metering);
+                                        if (! result.isVoid())
+                                            results.add (result);
+                                    }
+        }
+    }
+
+    auto* root = new juce::DynamicObject();
+    root->setProperty ("kernel", useReference ? "reference" : MultiplyKernel::getImplementationName (MultiplyKernel::getBestImplementation<float>()));
+    root->setProperty ("signal", inputFile.existsAsFile() ? inputFile.getFileName() : juce::String ("synthetic"));
+    root->setProperty ("seconds", seconds);
+    root->setProperty ("results", results);
+
+    const auto json = juce::JSON::toString (juce::var (root));
+
+    if (args.containsOption ("--output"))
+        juce::File::getCurrentWorkingDirectory().getChildFile (args.getValueForOption ("--output")).replaceWithText (json);
+    else
+        std::cout << json << std::endl;
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,253 @@
+/*
+  ==============================================================================
+
+    DelayLine.h
+    Multichannel delay line with fractional delay (linear, lagrange-3 or allpass
+    interpolation). A change of the delay is ramped linearly over the next block,
+    every channel can have its own delay.
+
+    The ring length is a power of two, so positions wrap with a bitmask.
+    Every read is split into at most two contiguous spans (before and after the
+    ring wraps around), a few mirrored guard samples at both ends of the ring let
+    the interpolation taps run over the end, so the inner loops have no wrap test.
+
+    SampleType is float or double, delays (in samples) are float either way.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+// outside the template, so float and double delay lines take the same setting
+enum class DelayInterpolation
+{
+    linear = 0,
+    lagrange3,
+    allpass
+};
+
+template <typename SampleType>
+class DelayLine
+{
+public:
+    using Interpolation = DelayInterpolation;
+
+    void prepare (int newNumChannels, int maxDelayInSamples, int maxBlockSize)
+    {
+        numChannels = newNumChannels;
+        maxDelay = maxDelayInSamples;
+
+        //room for the oldest tap of the longest delay plus a full block of new samples
+        ringLength = 1;
+        while (ringLength < maxDelay + maxBlockSize + 4)
+            ringLength *= 2;
+
+        mask = ringLength - 1;
+        channelStride = ringLength + 2 * guard;
+
+        data.assign (static_cast<size_t> (numChannels * channelStride), SampleType (0));
+        allpassState.assign (static_cast<size_t> (numChannels), SampleType (0));
+        currentDelays.assign (static_cast<size_t> (numChannels), 0.0f);
+        targetDelays.assign (static_cast<size_t> (numChannels), 0.0f);
+        reset();
+    }
+
+    void reset()
+    {
+        std::fill (data.begin(), data.end(), SampleType (0));
+        std::fill (allpassState.begin(), allpassState.end(), SampleType (0));
+        writeIndex = 0;
+        currentDelays = targetDelays;
+    }
+
+    // reset() of a single channel, the write position (shared by all) stays
+    void resetChannel (int channel)
+    {
+        std::fill_n (data.begin() + channel * channelStride, channelStride, SampleType (0));
+        allpassState[static_cast<size_t> (channel)] = SampleType (0);
+        currentDelays[static_cast<size_t> (channel)] = targetDelays[static_cast<size_t> (channel)];
+    }
+
+    void setInterpolation (Interpolation newInterpolation)
+    {
+        if (interpolation != newInterpolation)
+            std::fill (allpassState.begin(), allpassState.end(), SampleType (0));
+
+        interpolation = newInterpolation;
+    }
+
+    Interpolation getInterpolation() const  { return interpolation; }
+
+    // delay in samples, it is reached at the end of the next block
+    void setDelay (float newDelayInSamples)
+    {
+        for (int channel = 0; channel < numChannels; channel++)
+            setDelay (channel, newDelayInSamples);
+    }
+
+    void setDelay (int channel, float newDelayInSamples)
+    {
+        targetDelays[static_cast<size_t> (channel)] = std::min (std::max (newDelayInSamples, 0.0f), static_cast<float> (maxDelay));
+    }
+
+    // call once per channel with the new block, before reading that channel
+    void write (int channel, const SampleType* input, int numSamples)
+    {
+        SampleType* ring = data.data() + channel * channelStride + guard;
+
+        const int firstPart = std::min (numSamples, ringLength - writeIndex);
+        std::memcpy (ring + writeIndex, input, sizeof (SampleType) * static_cast<size_t> (firstPart));
+        std::memcpy (ring, input + firstPart, sizeof (SampleType) * static_cast<size_t> (numSamples - firstPart));
+
+        //mirror both ends into the guards
+        std::memcpy (ring - guard, ring + ringLength - guard, sizeof (SampleType) * guard);
+        std::memcpy (ring + ringLength, ring, sizeof (SampleType) * guard);
+    }
+
+    // delayed signal of the block written last for this channel
+    void read (int channel, SampleType* output, int numSamples)
+    {
+        const SampleType* ring = data.data() + channel * channelStride + guard;
+        const float currentDelay = currentDelays[static_cast<size_t> (channel)];
+        const float targetDelay = targetDelays[static_cast<size_t> (channel)];
+
+        //lagrange and allpass need at least one sample of delay to only read past samples,
+        //a delay that stays at 0 is still exact as it's just a copy
+        const float minDelay = interpolation == Interpolation::linear || (currentDelay == 0.0f && targetDelay == 0.0f) ? 0.0f : 1.0f;
+        const float startDelay = std::max (currentDelay, minDelay);
+
+        float step = (std::max (targetDelay, minDelay) - startDelay) / static_cast<float> (numSamples);
+        step = std::min (step, 1.0f); //faster would make the read position run backwards
+
+        //tap position of a sample relative to the write index, only depends on the integer part of the delay
+        auto tapPosition = [&] (int i) { return writeIndex + i - static_cast<int> (startDelay + static_cast<float> (i) * step); };
+
+        //the positions of one block cover less than the ring length, so they wrap at most once.
+        //origin is the multiple of the ring length just below the first position
+        const int firstPosition = tapPosition (0);
+        const int origin = firstPosition - (firstPosition & mask);
+
+        int split = numSamples;
+        if (tapPosition (numSamples - 1) - origin >= ringLength)
+        {
+            int lo = 0;
+            int hi = numSamples;
+            while (lo < hi)
+            {
+                const int mid = (lo + hi) / 2;
+                if (tapPosition (mid) - origin >= ringLength)
+                    hi = mid;
+                else
+                    lo = mid + 1;
+            }
+            split = lo;
+        }
+
+        SampleType& state = allpassState[static_cast<size_t> (channel)];
+
+        readSpan (ring - origin, output, 0, split, startDelay, step, state);
+        readSpan (ring - origin - ringLength, output, split, numSamples, startDelay, step, state);
+    }
+
+    // call after all channels have been written and read
+    void finishBlock (int numSamples)
+    {
+        writeIndex = (writeIndex + numSamples) & mask;
+
+        currentDelays = targetDelays;
+    }
+
+    size_t getMemoryUsageInBytes() const
+    {
+        return sizeof (SampleType) * (data.size() + allpassState.size()) + sizeof (float) * (currentDelays.size() + targetDelays.size());
+    }
+
+private:
+    void readSpan (const SampleType* ring, SampleType* output, int start, int end, float startDelay, float step, SampleType& state) const
+    {
+        if (start >= end)
+            return;
+
+        const SampleType* x = ring + writeIndex;
+
+        if (step == 0.0f)
+        {
+            const int delayInt = static_cast<int> (startDelay);
+            const float frac = startDelay - static_cast<float> (delayInt);
+
+            if (frac == 0.0f)
+            {
+                std::memcpy (output + start, x + start - delayInt, sizeof (SampleType) * static_cast<size_t> (end - start));
+                return;
+            }
+        }
+
+        switch (interpolation)
+        {
+            case Interpolation::linear:
+                for (int i = start; i < end; i++)
+                {
+                    const float delay = startDelay + static_cast<float> (i) * step;
+                    const int delayInt = static_cast<int> (delay);
+                    const SampleType frac = delay - static_cast<float> (delayInt);
+                    const SampleType* tap = x + i - delayInt;
+
+                    output[i] = tap[0] + frac * (tap[-1] - tap[0]);
+                }
+                break;
+
+            case Interpolation::lagrange3:
+                for (int i = start; i < end; i++)
+                {
+                    const float delay = startDelay + static_cast<float> (i) * step;
+                    const int delayInt = static_cast<int> (delay);
+                    const SampleType* tap = x + i - delayInt - 1; //points -1..2 around tap, position f in (0, 1]
+                    const SampleType f = 1.0f - (delay - static_cast<float> (delayInt));
+
+                    const SampleType fm1 = f - SampleType (1);
+                    const SampleType fm2 = f - SampleType (2);
+                    const SampleType fp1 = f + SampleType (1);
+
+                    output[i] = -f * fm1 * fm2 * (SampleType (1) / SampleType (6)) * tap[-1]
+                              + fp1 * fm1 * fm2 * SampleType (0.5) * tap[0]
+                              - fp1 * f * fm2 * SampleType (0.5) * tap[1]
+                              + fp1 * f * fm1 * (SampleType (1) / SampleType (6)) * tap[2];
+                }
+                break;
+
+            case Interpolation::allpass:
+                for (int i = start; i < end; i++)
+                {
+                    //fractional part kept in [0.5, 1.5) where the allpass behaves best
+                    const float delay = startDelay + static_cast<float> (i) * step;
+                    const int delayInt = static_cast<int> (delay - 0.5f);
+                    const SampleType frac = delay - static_cast<float> (delayInt);
+                    const SampleType eta = (SampleType (1) - frac) / (SampleType (1) + frac);
+                    const SampleType* tap = x + i - delayInt;
+
+                    state = eta * tap[0] + tap[-1] - eta * state;
+                    output[i] = state;
+                }
+                break;
+        }
+    }
+
+    static constexpr int guard = 4;
+
+    std::vector<SampleType> data;
+    std::vector<SampleType> allpassState;
+    int numChannels = 0;
+    int maxDelay = 0;
+    int ringLength = 0;
+    int mask = 0;
+    int channelStride = 0;
+    int writeIndex = 0;
+
+    std::vector<float> currentDelays;
+    std::vector<float> targetDelays;
+    Interpolation interpolation = Interpolation::linear;
+};
@@ -0,0 +1,61 @@
+/*
+  ==============================================================================
+
+    ExponentPolicy.h
+    Compile time versions of pow (x, exp) for the exp values that get used
+    the most (0, 0.5, 1 and 2), so the hot loops can skip the transcendental math.
+
+    dispatch() picks the policy once per block, a value counts only if it sits
+    exactly on one of those, everything else (e.g. while smoothing) is Generic.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <cmath>
+
+namespace ExponentPolicy
+{
+    // pow (x, 0) is 1, also for x = 0
+    struct Zero
+    {
+        template <typename T>
+        static T apply (T, T) { return T (1); }
+    };
+
+    struct Sqrt
+    {
+        template <typename T>
+        static T apply (T x, T) { return std::sqrt (x); }
+    };
+
+    struct Identity
+    {
+        template <typename T>
+        static T apply (T x, T) { return x; }
+    };
+
+    struct Square
+    {
+        template <typename T>
+        static T apply (T x, T) { return x * x; }
+    };
+
+    struct Generic
+    {
+        template <typename T>
+        static T apply (T x, T exponent) { return std::pow (x, exponent); }
+    };
+
+    template <typename T, typename Function>
+    auto dispatch (T exponent, Function&& function)
+    {
+        if (exponent == T (1))      return function (Identity());
+        if (exponent == T (0))      return function (Zero());
+        if (exponent == T (2))      return function (Square());
+        if (exponent == T (0.5))    return function (Sqrt());
+
+        return function (Generic());
+    }
+}
@@ -0,0 +1,91 @@
+/*
+  ==============================================================================
+
+    FastMath.h
+    Approximations of log2/exp2 used to replace pow() in the hot loops.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+namespace FastMath
+{
+    // minimax polynomials (log2 on the mantissa in [1,2), exp2 on [0,1))
+    // max relative error of pow (x, e) = exp2 (e * log2 (x)) is below 3e-5 for e <= 3
+    // and x in the normal float range, which is way below anything audible here
+    constexpr float log2Coefs[] = { 3.1157899f, -3.3241990f, 2.5988452f, -1.2315303f, 3.1821337e-1f, -3.4436006e-2f };
+    constexpr float exp2Coefs[] = { 9.9999994e-1f, 6.9315308e-1f, 2.4015361e-1f, 5.5826318e-2f, 8.9893397e-3f, 1.8775767e-3f };
+
+    // exp2 input is clamped to this range so the exponent bits can't overflow
+    constexpr float exp2Min = -126.0f;
+    constexpr float exp2Max = 127.0f;
+
+    // the same for double, as series instead of minimax polynomials, good to a few ulp:
+    // log2 (m) = 2/ln2 * (f + f^3/3 + f^5/5 ...) with f = (m-1)/(m+1) and the mantissa m in [sqrt(0.5), sqrt(2)),
+    // the coefs are 2/(ln2 (2k+1)) for the odd powers. exp2 (r) = sum of (r ln2)^k/k! for r in [-0.5, 0.5]
+    constexpr double log2DoubleCoefs[] = { 2.8853900817779268, 0.96179669392597567, 0.57707801635558531, 0.41219858311113244,
+                                           0.3205988979753252, 0.26230818925253879, 0.2219530832136867, 0.19235933878519512,
+                                           0.16972882833987804, 0.15186263588304877, 0.13739952770371081 };
+    constexpr double exp2DoubleCoefs[] = { 1.0, 0.69314718055994529, 0.24022650695910069, 0.055504108664821576,
+                                           0.0096181291076284769, 0.0013333558146428441, 0.00015403530393381606,
+                                           1.5252733804059838e-05, 1.3215486790144305e-06, 1.0178086009239696e-07,
+                                           7.0549116208011209e-09, 4.4455382718708101e-10, 2.5678435993488196e-11,
+                                           1.3691488853904124e-12 };
+    constexpr int numLog2DoubleCoefs = static_cast<int> (sizeof (log2DoubleCoefs) / sizeof (double));
+    constexpr int numExp2DoubleCoefs = static_cast<int> (sizeof (exp2DoubleCoefs) / sizeof (double));
+    constexpr double exp2DoubleMin = -1022.0;
+    constexpr double exp2DoubleMax = 1023.0;
+
+    inline float fastLog2 (float x)
+    {
+        uint32_t bits;
+        std::memcpy (&bits, &x, sizeof (bits));
+
+        const float exponent = static_cast<float> (static_cast<int> ((bits >> 23) & 0xff) - 127);
+
+        bits = (bits & 0x007fffff) | 0x3f800000;
+        float mantissa;
+        std::memcpy (&mantissa, &bits, sizeof (mantissa));
+
+        float p = log2Coefs[5];
+        for (int i = 4; i >= 0; i--)
+            p = p * mantissa + log2Coefs[i];
+
+        return p * (mantissa - 1.0f) + exponent;
+    }
+
+    inline float fastExp2 (float x)
+    {
+        x = x < exp2Min ? exp2Min : (x > exp2Max ? exp2Max : x);
+
+        //floor by truncation, same way the simd versions do it
+        float floored = static_cast<float> (static_cast<int> (x));
+        floored -= floored > x ? 1.0f : 0.0f;
+
+        const int ipart = static_cast<int> (floored);
+        const float fpart = x - floored;
+
+        const uint32_t bits = static_cast<uint32_t> (ipart + 127) << 23;
+        float scale;
+        std::memcpy (&scale, &bits, sizeof (scale));
+
+        float p = exp2Coefs[5];
+        for (int i = 4; i >= 0; i--)
+            p = p * fpart + exp2Coefs[i];
+
+        return scale * p;
+    }
+
+    // |x|^e for x >= 0, pow (0, e) = 0 for e > 0 and 1 for e == 0 like std::pow
+    inline float fastPow (float x, float e)
+    {
+        if (x <= 0.0f)
+            return e == 0.0f ? 1.0f : 0.0f;
+
+        return fastExp2 (e * fastLog2 (x));
+    }
+}
@@ -0,0 +1,110 @@
+/*
+  ==============================================================================
+
+    Lfo.h
+    Control rate LFO for modulating d and exp.
+
+    It's only evaluated once per sub-block (and channel), the delay line ramps
+    linearly between those points, so modulation costs a handful of operations
+    per sub-block instead of per sample. The phase is either free running or
+    taken from the host's ppq position for tempo sync.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+
+class Lfo
+{
+public:
+    enum class Shape
+    {
+        sine = 0,
+        triangle,
+        saw,
+        square,
+        random //sample and hold, a new value every cycle
+    };
+
+    void prepare (double newSampleRate)
+    {
+        sampleRate = newSampleRate;
+        reset();
+    }
+
+    void reset()
+    {
+        phase = 0;
+        cycle = 0;
+    }
+
+    void setShape (Shape newShape)              { shape = newShape; }
+    void setFrequency (double newFrequency)     { frequency = newFrequency; }
+
+    // tempo sync: jumps to the phase the playhead position gives, frequency follows the tempo
+    void syncToPosition (double ppqPosition, double bpm, double beatsPerCycle)
+    {
+        const double cycles = ppqPosition / beatsPerCycle;
+        cycle = static_cast<int64_t> (std::floor (cycles));
+        phase = cycles - static_cast<double> (cycle);
+        frequency = bpm / 60.0 / beatsPerCycle;
+    }
+
+    void advance (int numSamples)
+    {
+        phase += frequency * numSamples / sampleRate;
+
+        if (phase >= 1.0)
+        {
+            const double wraps = std::floor (phase);
+            phase -= wraps;
+            cycle += static_cast<int64_t> (wraps);
+        }
+    }
+
+    // -1 .. 1 at the current phase shifted by phaseOffset cycles (0 .. 1)
+    float getValue (double phaseOffset) const
+    {
+        double p = phase + phaseOffset;
+        int64_t c = cycle;
+        if (p >= 1.0)
+        {
+            p -= 1.0;
+            c++;
+        }
+
+        switch (shape)
+        {
+            case Shape::sine:       return static_cast<float> (std::sin (2.0 * 3.14159265358979323846 * p));
+            case Shape::triangle:   return static_cast<float> (p < 0.5 ? 4.0 * p - 1.0 : 3.0 - 4.0 * p);
+            case Shape::saw:        return static_cast<float> (2.0 * p - 1.0);
+            case Shape::square:     return p < 0.5 ? 1.0f : -1.0f;
+            case Shape::random:     return randomValue (c);
+        }
+
+        return 0;
+    }
+
+private:
+    // same value for the same cycle, so channels with an offset get the same steps shifted
+    static float randomValue (int64_t c)
+    {
+        uint32_t x = static_cast<uint32_t> (c) * 0x9e3779b9u + 0x7f4a7c15u;
+        x ^= x >> 16;
+        x *= 0x85ebca6bu;
+        x ^= x >> 13;
+        x *= 0xc2b2ae35u;
+        x ^= x >> 16;
+
+        return static_cast<float> (x) / 2147483648.0f - 1.0f;
+    }
+
+    double sampleRate = 44100;
+    double frequency = 1;
+    double phase = 0;
+    int64_t cycle = 0;
+    Shape shape = Shape::sine;
+};
@@ -0,0 +1,116 @@
+/*
+  ==============================================================================
+
+    MeterDisplay.cpp
+
+  ==============================================================================
+*/
+
+#include "MeterDisplay.h"
+
+MeterDisplay::MeterDisplay (SelfMultAudioProcessor& p)
+    : audioProcessor (p)
+{
+    gainTrace.fill (traceMinDb);
+    setOpaque (false);
+
+    //frames left from an earlier editor would show up as a jump
+    while (audioProcessor.getMeterFifo().pop (popped.data(), (int) popped.size()) > 0) {}
+
+    audioProcessor.setMeteringEnabled (true);
+    startTimerHz (30);
+}
+
+MeterDisplay::~MeterDisplay()
+{
+    stopTimer();
+    audioProcessor.setMeteringEnabled (false);
+}
+
+void MeterDisplay::timerCallback()
+{
+    const int numFrames = audioProcessor.getMeterFifo().pop (popped.data(), (int) popped.size());
+
+    float inputPeak = 0, outputPeak = 0;
+    bool softAttack = false;
+    for (int i = 0; i < numFrames; ++i)
+    {
+        const auto& frame = popped[(size_t) i];
+        inputPeak = juce::jmax (inputPeak, frame.inputPeak);
+        outputPeak = juce::jmax (outputPeak, frame.outputPeak);
+
+        gainTrace[(size_t) traceWritePos] = juce::jlimit (traceMinDb, traceMaxDb, juce::Decibels::gainToDecibels (frame.gain, traceMinDb));
+        traceWritePos = (traceWritePos + 1) % numTraceFrames;
+
+        softAttack = softAttack || frame.softAttack;
+    }
+
+    //instant attack, linear release in dB
+    inputLevel = juce::jmax (inputLevel - decayDbPerTick, juce::Decibels::gainToDecibels (inputPeak, minDb));
+    outputLevel = juce::jmax (outputLevel - decayDbPerTick, juce::Decibels::gainToDecibels (outputPeak, minDb));
+
+    softAttackHold = softAttack ? 6 : juce::jmax (0, softAttackHold - 1); //lit for at least 200ms
+
+    repaint();
+}
+
+void MeterDisplay::paint (juce::Graphics& g)
+{
+    auto bounds = getLocalBounds().toFloat();
+    const auto labelHeight = 16.0f;
+
+    //two meter bars on the left
+    auto meters = bounds.removeFromLeft (44.0f);
+    auto drawMeter = [&] (juce::Rectangle<float> area, float level, const juce::String& name)
+    {
+        g.setColour (juce::Colours::lightgrey);
+        g.drawFittedText (name, area.removeFromBottom (labelHeight).toNearestInt(), juce::Justification::centred, 1);
+
+        g.setColour (juce::Colours::black.withAlpha (0.4f));
+        g.fillRect (area);
+
+        const float proportion = juce::jlimit (0.0f, 1.0f, (level - minDb) / -minDb);
+        g.setColour (level > -0.1f ? juce::Colours::red : juce::Colours::limegreen);
+        g.fillRect (area.withTop (area.getBottom() - proportion * area.getHeight()));
+    };
+    drawMeter (meters.removeFromLeft (20.0f).reduced (2.0f, 0.0f), inputLevel, "in");
+    drawMeter (meters.removeFromLeft (20.0f).reduced (2.0f, 0.0f), outputLevel, "out");
+
+    bounds.removeFromLeft (6.0f);
+
+    //soft attack indicator above the trace
+    auto header = bounds.removeFromTop (labelHeight);
+    g.setColour (juce::Colours::lightgrey);
+    g.drawFittedText ("rms gain", header.toNearestInt(), juce::Justification::centredLeft, 1);
+
+    auto led = header.removeFromRight (labelHeight).reduced (3.0f);
+    g.setColour (softAttackHold > 0 ? juce::Colours::orange : juce::Colours::black.withAlpha (0.4f));
+    g.fillEllipse (led);
+    g.setColour (juce::Colours::lightgrey);
+    g.drawFittedText ("soft attack", header.removeFromRight (70.0f).toNearestInt(), juce::Justification::centredRight, 1);
+
+    //gain trace, oldest frame on the left
+    auto trace = bounds.withTrimmedBottom (labelHeight);
+    g.setColour (juce::Colours::black.withAlpha (0.4f));
+    g.fillRect (trace);
+
+    auto yForDb = [&] (float db) { return juce::jmap (db, traceMinDb, traceMaxDb, trace.getBottom(), trace.getY()); };
+
+    g.setColour (juce::Colours::grey);
+    g.drawHorizontalLine (juce::roundToInt (yForDb (0.0f)), trace.getX(), trace.getRight());
+
+    juce::Path path;
+    for (int i = 0; i < numTraceFrames; ++i)
+    {
+        const float x = trace.getX() + trace.getWidth() * (float) i / (float) (numTraceFrames - 1);
+        const float y = yForDb (gainTrace[(size_t) ((traceWritePos + i) % numTraceFrames)]);
+
+        if (i == 0)
+            path.startNewSubPath (x, y);
+        else
+            path.lineTo (x, y);
+    }
+
+    g.setColour (juce::Colours::skyblue);
+    g.strokePath (path, juce::PathStrokeType (1.5f));
+}
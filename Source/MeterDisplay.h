@@ -0,0 +1,52 @@
+/*
+  ==============================================================================
+
+    MeterDisplay.h
+    Input/output meters, a trace of the rms gain and a soft attack indicator.
+
+    Pops the processor's MeterFifo on a 30Hz timer and only repaints then,
+    so the audio thread never waits for it. Metering is switched on in the
+    processor while this exists.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "PluginProcessor.h"
+
+class MeterDisplay  : public juce::Component,
+                      private juce::Timer
+{
+public:
+    explicit MeterDisplay (SelfMultAudioProcessor&);
+    ~MeterDisplay() override;
+
+    void paint (juce::Graphics&) override;
+
+private:
+    void timerCallback() override;
+
+    SelfMultAudioProcessor& audioProcessor;
+
+    //decayed peaks in dB
+    float inputLevel = minDb;
+    float outputLevel = minDb;
+
+    //gain of the last numTraceFrames frames in dB, newest at traceWritePos - 1
+    static constexpr int numTraceFrames = 200; //2s
+    std::array<float, numTraceFrames> gainTrace;
+    int traceWritePos = 0;
+
+    int softAttackHold = 0; //timer ticks the indicator stays lit
+
+    std::array<MeterFrame, MeterFifo::capacity> popped;
+
+    static constexpr float minDb = -60.0f;
+    static constexpr float traceMinDb = -24.0f;
+    static constexpr float traceMaxDb = 72.0f; //quiet input gets boosted a lot with high exp
+    static constexpr float decayDbPerTick = 1.5f;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (MeterDisplay)
+};
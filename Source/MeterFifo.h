@@ -0,0 +1,68 @@
+/*
+  ==============================================================================
+
+    MeterFifo.h
+    Meter frames from the audio thread to the editor.
+
+    The processor decimates the audio to one frame every few ms and pushes it
+    here, the editor pops whatever arrived on its timer. Single producer, single
+    consumer on a juce::AbstractFifo, so both sides are wait-free and there's no
+    lock the audio thread could block on. When the editor is too slow (or gone)
+    new frames are dropped.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <array>
+
+struct MeterFrame
+{
+    float inputPeak = 0;    //max |sample| over all channels during the frame
+    float outputPeak = 0;
+    float gain = 0;         //rms gain (with soft attack) at the end of the frame, averaged over the channels
+    bool softAttack = false; //a soft attack started during the frame
+};
+
+class MeterFifo
+{
+public:
+    static constexpr int capacity = 256; //~2.5s of 10ms frames
+
+    // audio thread only
+    bool push (const MeterFrame& frame)
+    {
+        int start1, size1, start2, size2;
+        fifo.prepareToWrite (1, start1, size1, start2, size2);
+
+        if (size1 + size2 < 1)
+            return false;
+
+        frames[(size_t) (size1 > 0 ? start1 : start2)] = frame;
+        fifo.finishedWrite (1);
+        return true;
+    }
+
+    // message thread only, returns how many frames were copied to dest
+    int pop (MeterFrame* dest, int maxFrames)
+    {
+        int start1, size1, start2, size2;
+        fifo.prepareToRead (maxFrames, start1, size1, start2, size2);
+
+        for (int i = 0; i < size1; ++i)
+            dest[i] = frames[(size_t) (start1 + i)];
+        for (int i = 0; i < size2; ++i)
+            dest[size1 + i] = frames[(size_t) (start2 + i)];
+
+        fifo.finishedRead (size1 + size2);
+        return size1 + size2;
+    }
+
+    int getNumReady() const     { return fifo.getNumReady(); }
+
+private:
+    juce::AbstractFifo fifo { capacity };
+    std::array<MeterFrame, capacity> frames;
+};
@@ -0,0 +1,350 @@
+/*
+  ==============================================================================
+
+    MultiplyKernel.cpp
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "MultiplyKernel.h"
+#include "MultiplyKernelImpl.h"
+
+#if SELFMULT_X86
+ #include <emmintrin.h>
+#elif SELFMULT_NEON
+ #include <arm_neon.h>
+#endif
+
+namespace
+{
+   #if SELFMULT_X86
+    struct Sse2Ops
+    {
+        using Sample = float;
+        using Vec = __m128;
+        static constexpr int width = 4;
+
+        static Vec load (const float* p)                { return _mm_loadu_ps (p); }
+        static void store (float* p, Vec v)             { _mm_storeu_ps (p, v); }
+        static Vec set1 (float v)                       { return _mm_set1_ps (v); }
+        static Vec set1Bits (int bits)                  { return _mm_castsi128_ps (_mm_set1_epi32 (bits)); }
+        static Vec add (Vec a, Vec b)                   { return _mm_add_ps (a, b); }
+        static Vec sub (Vec a, Vec b)                   { return _mm_sub_ps (a, b); }
+        static Vec mul (Vec a, Vec b)                   { return _mm_mul_ps (a, b); }
+        static Vec div (Vec a, Vec b)                   { return _mm_div_ps (a, b); }
+        static Vec mulAdd (Vec a, Vec b, Vec c)         { return _mm_add_ps (_mm_mul_ps (a, b), c); }
+        static Vec sqrt (Vec a)                         { return _mm_sqrt_ps (a); }
+        static Vec bitAnd (Vec a, Vec b)                { return _mm_and_ps (a, b); }
+        static Vec bitXor (Vec a, Vec b)                { return _mm_xor_ps (a, b); }
+        static Vec lessThan (Vec a, Vec b)              { return _mm_cmplt_ps (a, b); }
+        static Vec greaterThan (Vec a, Vec b)           { return _mm_cmpgt_ps (a, b); }
+        static Vec clamp (Vec x, Vec lo, Vec hi)        { return _mm_min_ps (_mm_max_ps (x, lo), hi); }
+
+        static Vec floor (Vec x)
+        {
+            //no round instruction before sse4.1, so truncate and fix up negative values
+            const auto truncated = _mm_cvtepi32_ps (_mm_cvttps_epi32 (x));
+            return _mm_sub_ps (truncated, _mm_and_ps (_mm_cmpgt_ps (truncated, x), _mm_set1_ps (1.0f)));
+        }
+
+        static Vec exponentOf (Vec x)
+        {
+            const auto biased = _mm_and_si128 (_mm_srli_epi32 (_mm_castps_si128 (x), 23), _mm_set1_epi32 (0xff));
+            return _mm_cvtepi32_ps (_mm_sub_epi32 (biased, _mm_set1_epi32 (127)));
+        }
+
+        static Vec mantissaOf (Vec x)
+        {
+            const auto bits = _mm_and_si128 (_mm_castps_si128 (x), _mm_set1_epi32 (0x007fffff));
+            return _mm_castsi128_ps (_mm_or_si128 (bits, _mm_set1_epi32 (0x3f800000)));
+        }
+
+        static Vec pow2 (Vec integral)
+        {
+            const auto biased = _mm_add_epi32 (_mm_cvttps_epi32 (integral), _mm_set1_epi32 (127));
+            return _mm_castsi128_ps (_mm_slli_epi32 (biased, 23));
+        }
+    };
+
+    struct Sse2DoubleOps
+    {
+        using Sample = double;
+        using Vec = __m128d;
+        static constexpr int width = 2;
+        static constexpr double twoTo52 = 4503599627370496.0;
+
+        static Vec load (const double* p)               { return _mm_loadu_pd (p); }
+        static void store (double* p, Vec v)            { _mm_storeu_pd (p, v); }
+        static Vec set1 (double v)                      { return _mm_set1_pd (v); }
+        static Vec set1Bits (int bits)                  { return _mm_castsi128_pd (_mm_set1_epi64x (bits)); }
+        static Vec add (Vec a, Vec b)                   { return _mm_add_pd (a, b); }
+        static Vec sub (Vec a, Vec b)                   { return _mm_sub_pd (a, b); }
+        static Vec mul (Vec a, Vec b)                   { return _mm_mul_pd (a, b); }
+        static Vec div (Vec a, Vec b)                   { return _mm_div_pd (a, b); }
+        static Vec mulAdd (Vec a, Vec b, Vec c)         { return _mm_add_pd (_mm_mul_pd (a, b), c); }
+        static Vec sqrt (Vec a)                         { return _mm_sqrt_pd (a); }
+        static Vec bitAnd (Vec a, Vec b)                { return _mm_and_pd (a, b); }
+        static Vec bitXor (Vec a, Vec b)                { return _mm_xor_pd (a, b); }
+        static Vec lessThan (Vec a, Vec b)              { return _mm_cmplt_pd (a, b); }
+        static Vec greaterThan (Vec a, Vec b)           { return _mm_cmpgt_pd (a, b); }
+        static Vec clamp (Vec x, Vec lo, Vec hi)        { return _mm_min_pd (_mm_max_pd (x, lo), hi); }
+
+        static Vec floor (Vec x)
+        {
+            //no round instruction and no 64 bit conversions in sse2, adding 1.5 * 2^52 rounds to integers
+            //(the 0.5 keeps negative x from landing below 2^52 where the spacing is only 0.5)
+            const auto magic = _mm_set1_pd (1.5 * twoTo52);
+            const auto rounded = _mm_sub_pd (_mm_add_pd (x, magic), magic);
+            return _mm_sub_pd (rounded, _mm_and_pd (_mm_cmpgt_pd (rounded, x), _mm_set1_pd (1.0)));
+        }
+
+        static Vec exponentOf (Vec x)
+        {
+            //the biased exponent or'ed into the mantissa of 2^52 is 2^52 + exponent
+            const auto biased = _mm_and_si128 (_mm_srli_epi64 (_mm_castpd_si128 (x), 52), _mm_set1_epi64x (0x7ff));
+            const auto asDouble = _mm_castsi128_pd (_mm_or_si128 (biased, _mm_castpd_si128 (_mm_set1_pd (twoTo52))));
+            return _mm_sub_pd (asDouble, _mm_set1_pd (twoTo52 + 1023.0));
+        }
+
+        static Vec mantissaOf (Vec x)
+        {
+            const auto bits = _mm_and_si128 (_mm_castpd_si128 (x), _mm_set1_epi64x (0x000fffffffffffffll));
+            return _mm_castsi128_pd (_mm_or_si128 (bits, _mm_set1_epi64x (0x3ff0000000000000ll)));
+        }
+
+        static Vec pow2 (Vec integral)
+        {
+            //same trick the other way round, the low bits of the sum are integral + 1023
+            const auto biased = _mm_castpd_si128 (_mm_add_pd (integral, _mm_set1_pd (twoTo52 + 1023.0)));
+            return _mm_castsi128_pd (_mm_slli_epi64 (biased, 52));
+        }
+    };
+   #endif
+
+   #if SELFMULT_NEON
+    struct NeonOps
+    {
+        using Sample = float;
+        using Vec = float32x4_t;
+        static constexpr int width = 4;
+
+        static uint32x4_t bits (Vec v)                  { return vreinterpretq_u32_f32 (v); }
+        static Vec fromBits (uint32x4_t v)              { return vreinterpretq_f32_u32 (v); }
+
+        static Vec load (const float* p)                { return vld1q_f32 (p); }
+        static void store (float* p, Vec v)             { vst1q_f32 (p, v); }
+        static Vec set1 (float v)                       { return vdupq_n_f32 (v); }
+        static Vec set1Bits (int v)                     { return fromBits (vdupq_n_u32 (static_cast<uint32_t> (v))); }
+        static Vec add (Vec a, Vec b)                   { return vaddq_f32 (a, b); }
+        static Vec sub (Vec a, Vec b)                   { return vsubq_f32 (a, b); }
+        static Vec mul (Vec a, Vec b)                   { return vmulq_f32 (a, b); }
+        static Vec div (Vec a, Vec b)                   { return vdivq_f32 (a, b); }
+        static Vec mulAdd (Vec a, Vec b, Vec c)         { return vmlaq_f32 (c, a, b); }
+        static Vec sqrt (Vec a)                         { return vsqrtq_f32 (a); }
+        static Vec bitAnd (Vec a, Vec b)                { return fromBits (vandq_u32 (bits (a), bits (b))); }
+        static Vec bitXor (Vec a, Vec b)                { return fromBits (veorq_u32 (bits (a), bits (b))); }
+        static Vec lessThan (Vec a, Vec b)              { return fromBits (vcltq_f32 (a, b)); }
+        static Vec greaterThan (Vec a, Vec b)           { return fromBits (vcgtq_f32 (a, b)); }
+        static Vec clamp (Vec x, Vec lo, Vec hi)        { return vminq_f32 (vmaxq_f32 (x, lo), hi); }
+
+        static Vec floor (Vec x)
+        {
+            const auto truncated = vcvtq_f32_s32 (vcvtq_s32_f32 (x));
+            return vsubq_f32 (truncated, bitAnd (greaterThan (truncated, x), vdupq_n_f32 (1.0f)));
+        }
+
+        static Vec exponentOf (Vec x)
+        {
+            const auto biased = vreinterpretq_s32_u32 (vandq_u32 (vshrq_n_u32 (bits (x), 23), vdupq_n_u32 (0xff)));
+            return vcvtq_f32_s32 (vsubq_s32 (biased, vdupq_n_s32 (127)));
+        }
+
+        static Vec mantissaOf (Vec x)
+        {
+            return fromBits (vorrq_u32 (vandq_u32 (bits (x), vdupq_n_u32 (0x007fffff)), vdupq_n_u32 (0x3f800000)));
+        }
+
+        static Vec pow2 (Vec integral)
+        {
+            const auto biased = vaddq_s32 (vcvtq_s32_f32 (integral), vdupq_n_s32 (127));
+            return vreinterpretq_f32_s32 (vshlq_n_s32 (biased, 23));
+        }
+    };
+
+    struct NeonDoubleOps
+    {
+        using Sample = double;
+        using Vec = float64x2_t;
+        static constexpr int width = 2;
+
+        static uint64x2_t bits (Vec v)                  { return vreinterpretq_u64_f64 (v); }
+        static Vec fromBits (uint64x2_t v)              { return vreinterpretq_f64_u64 (v); }
+
+        static Vec load (const double* p)               { return vld1q_f64 (p); }
+        static void store (double* p, Vec v)            { vst1q_f64 (p, v); }
+        static Vec set1 (double v)                      { return vdupq_n_f64 (v); }
+        static Vec set1Bits (int v)                     { return fromBits (vdupq_n_u64 (static_cast<uint64_t> (static_cast<int64_t> (v)))); }
+        static Vec add (Vec a, Vec b)                   { return vaddq_f64 (a, b); }
+        static Vec sub (Vec a, Vec b)                   { return vsubq_f64 (a, b); }
+        static Vec mul (Vec a, Vec b)                   { return vmulq_f64 (a, b); }
+        static Vec div (Vec a, Vec b)                   { return vdivq_f64 (a, b); }
+        static Vec mulAdd (Vec a, Vec b, Vec c)         { return vfmaq_f64 (c, a, b); }
+        static Vec sqrt (Vec a)                         { return vsqrtq_f64 (a); }
+        static Vec bitAnd (Vec a, Vec b)                { return fromBits (vandq_u64 (bits (a), bits (b))); }
+        static Vec bitXor (Vec a, Vec b)                { return fromBits (veorq_u64 (bits (a), bits (b))); }
+        static Vec lessThan (Vec a, Vec b)              { return fromBits (vcltq_f64 (a, b)); }
+        static Vec greaterThan (Vec a, Vec b)           { return fromBits (vcgtq_f64 (a, b)); }
+        static Vec clamp (Vec x, Vec lo, Vec hi)        { return vminq_f64 (vmaxq_f64 (x, lo), hi); }
+        static Vec floor (Vec x)                        { return vrndmq_f64 (x); }
+
+        static Vec exponentOf (Vec x)
+        {
+            const auto biased = vreinterpretq_s64_u64 (vandq_u64 (vshrq_n_u64 (bits (x), 52), vdupq_n_u64 (0x7ff)));
+            return vcvtq_f64_s64 (vsubq_s64 (biased, vdupq_n_s64 (1023)));
+        }
+
+        static Vec mantissaOf (Vec x)
+        {
+            return fromBits (vorrq_u64 (vandq_u64 (bits (x), vdupq_n_u64 (0x000fffffffffffffull)), vdupq_n_u64 (0x3ff0000000000000ull)));
+        }
+
+        static Vec pow2 (Vec integral)
+        {
+            const auto biased = vaddq_s64 (vcvtq_s64_f64 (integral), vdupq_n_s64 (1023));
+            return vreinterpretq_f64_s64 (vshlq_n_s64 (biased, 52));
+        }
+    };
+   #endif
+}
+
+namespace MultiplyKernel
+{
+    template <typename SampleType>
+    static void processReferenceImpl (SampleType* channelData, const SampleType* delayData, const SampleType* rmsSums,
+                                      const SampleType* softAttackFactors, int numSamples, const Settings<SampleType>& settings)
+    {
+        int negative;
+        SampleType delaySample;
+        SampleType volumeCoef;
+        for (int sample = 0; sample < numSamples; sample++)
+        {
+            const SampleType exponent = settings.exponent + static_cast<SampleType> (sample) * settings.exponentStep;
+
+            //if volume too low use 0 to avoid having a near inf factor
+            if (rmsSums[sample] < settings.rmsThreshold)
+                volumeCoef = 0;
+            else
+                volumeCoef = static_cast<SampleType> (softAttackFactors[sample] / std::pow (std::sqrt (static_cast<double> (rmsSums[sample]) * settings.rmsNormalisation), static_cast<double> (exponent)));
+
+            delaySample = delayData[sample];
+
+            //checking if result should be negative or positive as we have to use the absolute value in the power function. (e.g. -2^2.5 cant be computed)
+            negative = channelData[sample] * delaySample < 0 ? -1 : 1;
+
+            channelData[sample] = channelData[sample] * std::pow (std::abs (delaySample), exponent) * volumeCoef * settings.userVol * negative;
+        }
+    }
+
+    template <typename SampleType>
+    static void processScalarImpl (SampleType* channelData, const SampleType* delayData, const SampleType* rmsSums,
+                                   const SampleType* softAttackFactors, int numSamples, const Settings<SampleType>& settings)
+    {
+        dispatch (settings, [&] (auto policy)
+        {
+            processScalarTail<decltype (policy)> (channelData, delayData, rmsSums, softAttackFactors, numSamples, settings);
+        });
+    }
+
+    void processReference (float* channelData, const float* delayData, const float* rmsSums,
+                           const float* softAttackFactors, int numSamples, const Settings<float>& settings)
+    {
+        processReferenceImpl (channelData, delayData, rmsSums, softAttackFactors, numSamples, settings);
+    }
+
+    void processReference (double* channelData, const double* delayData, const double* rmsSums,
+                           const double* softAttackFactors, int numSamples, const Settings<double>& settings)
+    {
+        processReferenceImpl (channelData, delayData, rmsSums, softAttackFactors, numSamples, settings);
+    }
+
+    void processScalar (float* channelData, const float* delayData, const float* rmsSums,
+                        const float* softAttackFactors, int numSamples, const Settings<float>& settings)
+    {
+        processScalarImpl (channelData, delayData, rmsSums, softAttackFactors, numSamples, settings);
+    }
+
+    void processScalar (double* channelData, const double* delayData, const double* rmsSums,
+                        const double* softAttackFactors, int numSamples, const Settings<double>& settings)
+    {
+        processScalarImpl (channelData, delayData, rmsSums, softAttackFactors, numSamples, settings);
+    }
+
+   #if SELFMULT_X86
+    void processSse2 (float* channelData, const float* delayData, const float* rmsSums,
+                      const float* softAttackFactors, int numSamples, const Settings<float>& settings)
+    {
+        processBlock<Sse2Ops> (channelData, delayData, rmsSums, softAttackFactors, numSamples, settings);
+    }
+
+    void processSse2 (double* channelData, const double* delayData, const double* rmsSums,
+                      const double* softAttackFactors, int numSamples, const Settings<double>& settings)
+    {
+        processBlock<Sse2DoubleOps> (channelData, delayData, rmsSums, softAttackFactors, numSamples, settings);
+    }
+   #endif
+
+   #if SELFMULT_NEON
+    void processNeon (float* channelData, const float* delayData, const float* rmsSums,
+                      const float* softAttackFactors, int numSamples, const Settings<float>& settings)
+    {
+        processBlock<NeonOps> (channelData, delayData, rmsSums, softAttackFactors, numSamples, settings);
+    }
+
+    void processNeon (double* channelData, const double* delayData, const double* rmsSums,
+                      const double* softAttackFactors, int numSamples, const Settings<double>& settings)
+    {
+        processBlock<NeonDoubleOps> (channelData, delayData, rmsSums, softAttackFactors, numSamples, settings);
+    }
+   #endif
+
+    template <typename SampleType>
+    static ProcessFunction<SampleType> getBestImplementationImpl()
+    {
+       #if SELFMULT_X86
+        if (juce::SystemStats::hasAVX2() && juce::SystemStats::hasFMA3())
+            return processAvx2;
+
+        return processSse2;
+       #elif SELFMULT_NEON
+        return processNeon;
+       #else
+        //std::pow beats the fast scalar version, that one is only meant for the simd tails
+        return processReference;
+       #endif
+    }
+
+    template <>
+    ProcessFunction<float> getBestImplementation<float>()       { return getBestImplementationImpl<float>(); }
+
+    template <>
+    ProcessFunction<double> getBestImplementation<double>()     { return getBestImplementationImpl<double>(); }
+
+    template <typename SampleType>
+    static const char* getImplementationNameImpl (ProcessFunction<SampleType> function)
+    {
+        if (function == static_cast<ProcessFunction<SampleType>> (processReference))   return "reference";
+        if (function == static_cast<ProcessFunction<SampleType>> (processScalar))      return "scalar";
+       #if SELFMULT_X86
+        if (function == static_cast<ProcessFunction<SampleType>> (processSse2))        return "sse2";
+        if (function == static_cast<ProcessFunction<SampleType>> (processAvx2))        return "avx2";
+       #endif
+       #if SELFMULT_NEON
+        if (function == static_cast<ProcessFunction<SampleType>> (processNeon))        return "neon";
+       #endif
+        return "unknown";
+    }
+
+    const char* getImplementationName (ProcessFunction<float> function)     { return getImplementationNameImpl (function); }
+    const char* getImplementationName (ProcessFunction<double> function)    { return getImplementationNameImpl (function); }
+}
@@ -0,0 +1,91 @@
+/*
+  ==============================================================================
+
+    MultiplyKernel.h
+    The rms gain and the main multiply stage of processBlock in one pass:
+    gain = softAttack / (rmsSum * normalisation)^(exp/2), or 0 where rmsSum < threshold
+    out = in * |delayed|^exp * gain * userVol, negated if in*delayed < 0
+    exp may ramp by exponentStep per sample, a ramp always takes the generic pow.
+
+    Every implementation exists for float and double, the double ones use
+    registers of half as many samples.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#if defined (__x86_64__) || defined (_M_X64) || defined (__i386__) || defined (_M_IX86)
+ #define SELFMULT_X86 1
+#else
+ #define SELFMULT_X86 0
+#endif
+
+#if (defined (__ARM_NEON) && defined (__aarch64__)) || defined (_M_ARM64)
+ #define SELFMULT_NEON 1
+#else
+ #define SELFMULT_NEON 0
+#endif
+
+namespace MultiplyKernel
+{
+    template <typename SampleType>
+    struct Settings
+    {
+        SampleType exponent;
+        SampleType userVol;
+        SampleType rmsNormalisation;
+        SampleType rmsThreshold;
+        SampleType exponentStep = 0; //exp of sample i is exponent + i * exponentStep
+    };
+
+    template <typename SampleType>
+    using ProcessFunction = void (*) (SampleType* channelData, const SampleType* delayData, const SampleType* rmsSums,
+                                      const SampleType* softAttackFactors, int numSamples, const Settings<SampleType>& settings);
+
+    // the original per sample loops with std::pow, kept as reference for the fast versions
+    void processReference (float* channelData, const float* delayData, const float* rmsSums,
+                           const float* softAttackFactors, int numSamples, const Settings<float>& settings);
+    void processReference (double* channelData, const double* delayData, const double* rmsSums,
+                           const double* softAttackFactors, int numSamples, const Settings<double>& settings);
+
+    // exact for exp 0, 0.5, 1 and 2 (see ExponentPolicy), otherwise fast log2/exp2 pow
+    // that differs from the reference by less than FastMath's error bound.
+    // the double versions compute the other exponents in double (series instead of the float polynomials,
+    // std::pow in the scalar one), within 3e-14 of the reference instead of the float bound of 3e-5
+    void processScalar (float* channelData, const float* delayData, const float* rmsSums,
+                        const float* softAttackFactors, int numSamples, const Settings<float>& settings);
+    void processScalar (double* channelData, const double* delayData, const double* rmsSums,
+                        const double* softAttackFactors, int numSamples, const Settings<double>& settings);
+
+   #if SELFMULT_X86
+    void processSse2 (float* channelData, const float* delayData, const float* rmsSums,
+                      const float* softAttackFactors, int numSamples, const Settings<float>& settings);
+    void processSse2 (double* channelData, const double* delayData, const double* rmsSums,
+                      const double* softAttackFactors, int numSamples, const Settings<double>& settings);
+
+    // lives in its own translation unit as it's compiled with avx2/fma enabled,
+    // only call this when the cpu supports it
+    void processAvx2 (float* channelData, const float* delayData, const float* rmsSums,
+                      const float* softAttackFactors, int numSamples, const Settings<float>& settings);
+    void processAvx2 (double* channelData, const double* delayData, const double* rmsSums,
+                      const double* softAttackFactors, int numSamples, const Settings<double>& settings);
+   #endif
+
+   #if SELFMULT_NEON
+    void processNeon (float* channelData, const float* delayData, const float* rmsSums,
+                      const float* softAttackFactors, int numSamples, const Settings<float>& settings);
+    void processNeon (double* channelData, const double* delayData, const double* rmsSums,
+                      const double* softAttackFactors, int numSamples, const Settings<double>& settings);
+   #endif
+
+    // picks the widest implementation the cpu we're running on supports
+    template <typename SampleType>
+    ProcessFunction<SampleType> getBestImplementation();
+
+    template <> ProcessFunction<float> getBestImplementation<float>();
+    template <> ProcessFunction<double> getBestImplementation<double>();
+
+    const char* getImplementationName (ProcessFunction<float> function);
+    const char* getImplementationName (ProcessFunction<double> function);
+}
@@ -0,0 +1,163 @@
+/*
+  ==============================================================================
+
+    MultiplyKernelAvx2.cpp
+    AVX2/FMA version of the rms gain and multiply stage. The whole file is compiled with
+    avx2 enabled, so it must not include JuceHeader or call any non-template
+    inline helpers (or templates that are instantiated the same way elsewhere),
+    otherwise the linker might pick avx2 code for other callers.
+
+  ==============================================================================
+*/
+
+#include "MultiplyKernel.h"
+
+#if SELFMULT_X86
+
+#include <immintrin.h>
+#include "ExponentPolicy.h"
+#include "FastMath.h"
+
+#if defined (__clang__)
+ #pragma clang attribute push (__attribute__ ((target ("avx2,fma"))), apply_to = function)
+#elif defined (__GNUC__)
+ #pragma GCC push_options
+ #pragma GCC target ("avx2,fma")
+#endif
+
+#include "MultiplyKernelImpl.h"
+
+namespace
+{
+    struct Avx2Ops
+    {
+        using Sample = float;
+        using Vec = __m256;
+        static constexpr int width = 8;
+
+        static Vec load (const float* p)                { return _mm256_loadu_ps (p); }
+        static void store (float* p, Vec v)             { _mm256_storeu_ps (p, v); }
+        static Vec set1 (float v)                       { return _mm256_set1_ps (v); }
+        static Vec set1Bits (int bits)                  { return _mm256_castsi256_ps (_mm256_set1_epi32 (bits)); }
+        static Vec add (Vec a, Vec b)                   { return _mm256_add_ps (a, b); }
+        static Vec sub (Vec a, Vec b)                   { return _mm256_sub_ps (a, b); }
+        static Vec mul (Vec a, Vec b)                   { return _mm256_mul_ps (a, b); }
+        static Vec div (Vec a, Vec b)                   { return _mm256_div_ps (a, b); }
+        static Vec mulAdd (Vec a, Vec b, Vec c)         { return _mm256_fmadd_ps (a, b, c); }
+        static Vec sqrt (Vec a)                         { return _mm256_sqrt_ps (a); }
+        static Vec bitAnd (Vec a, Vec b)                { return _mm256_and_ps (a, b); }
+        static Vec bitXor (Vec a, Vec b)                { return _mm256_xor_ps (a, b); }
+        static Vec lessThan (Vec a, Vec b)              { return _mm256_cmp_ps (a, b, _CMP_LT_OQ); }
+        static Vec greaterThan (Vec a, Vec b)           { return _mm256_cmp_ps (a, b, _CMP_GT_OQ); }
+        static Vec clamp (Vec x, Vec lo, Vec hi)        { return _mm256_min_ps (_mm256_max_ps (x, lo), hi); }
+        static Vec floor (Vec x)                        { return _mm256_floor_ps (x); }
+
+        static Vec exponentOf (Vec x)
+        {
+            const auto biased = _mm256_and_si256 (_mm256_srli_epi32 (_mm256_castps_si256 (x), 23), _mm256_set1_epi32 (0xff));
+            return _mm256_cvtepi32_ps (_mm256_sub_epi32 (biased, _mm256_set1_epi32 (127)));
+        }
+
+        static Vec mantissaOf (Vec x)
+        {
+            const auto bits = _mm256_and_si256 (_mm256_castps_si256 (x), _mm256_set1_epi32 (0x007fffff));
+            return _mm256_castsi256_ps (_mm256_or_si256 (bits, _mm256_set1_epi32 (0x3f800000)));
+        }
+
+        static Vec pow2 (Vec integral)
+        {
+            const auto biased = _mm256_add_epi32 (_mm256_cvttps_epi32 (integral), _mm256_set1_epi32 (127));
+            return _mm256_castsi256_ps (_mm256_slli_epi32 (biased, 23));
+        }
+    };
+
+    struct Avx2DoubleOps
+    {
+        using Sample = double;
+        using Vec = __m256d;
+        static constexpr int width = 4;
+        static constexpr double twoTo52 = 4503599627370496.0;
+
+        static Vec load (const double* p)               { return _mm256_loadu_pd (p); }
+        static void store (double* p, Vec v)            { _mm256_storeu_pd (p, v); }
+        static Vec set1 (double v)                      { return _mm256_set1_pd (v); }
+        static Vec set1Bits (int bits)                  { return _mm256_castsi256_pd (_mm256_set1_epi64x (bits)); }
+        static Vec add (Vec a, Vec b)                   { return _mm256_add_pd (a, b); }
+        static Vec sub (Vec a, Vec b)                   { return _mm256_sub_pd (a, b); }
+        static Vec mul (Vec a, Vec b)                   { return _mm256_mul_pd (a, b); }
+        static Vec div (Vec a, Vec b)                   { return _mm256_div_pd (a, b); }
+        static Vec mulAdd (Vec a, Vec b, Vec c)         { return _mm256_fmadd_pd (a, b, c); }
+        static Vec sqrt (Vec a)                         { return _mm256_sqrt_pd (a); }
+        static Vec bitAnd (Vec a, Vec b)                { return _mm256_and_pd (a, b); }
+        static Vec bitXor (Vec a, Vec b)                { return _mm256_xor_pd (a, b); }
+        static Vec lessThan (Vec a, Vec b)              { return _mm256_cmp_pd (a, b, _CMP_LT_OQ); }
+        static Vec greaterThan (Vec a, Vec b)           { return _mm256_cmp_pd (a, b, _CMP_GT_OQ); }
+        static Vec clamp (Vec x, Vec lo, Vec hi)        { return _mm256_min_pd (_mm256_max_pd (x, lo), hi); }
+        static Vec floor (Vec x)                        { return _mm256_floor_pd (x); }
+
+        static Vec exponentOf (Vec x)
+        {
+            //no int64 to double conversion before avx512, see Sse2DoubleOps
+            const auto biased = _mm256_and_si256 (_mm256_srli_epi64 (_mm256_castpd_si256 (x), 52), _mm256_set1_epi64x (0x7ff));
+            const auto asDouble = _mm256_castsi256_pd (_mm256_or_si256 (biased, _mm256_castpd_si256 (_mm256_set1_pd (twoTo52))));
+            return _mm256_sub_pd (asDouble, _mm256_set1_pd (twoTo52 + 1023.0));
+        }
+
+        static Vec mantissaOf (Vec x)
+        {
+            const auto bits = _mm256_and_si256 (_mm256_castpd_si256 (x), _mm256_set1_epi64x (0x000fffffffffffffll));
+            return _mm256_castsi256_pd (_mm256_or_si256 (bits, _mm256_set1_epi64x (0x3ff0000000000000ll)));
+        }
+
+        static Vec pow2 (Vec integral)
+        {
+            const auto biased = _mm256_castpd_si256 (_mm256_add_pd (integral, _mm256_set1_pd (twoTo52 + 1023.0)));
+            return _mm256_castsi256_pd (_mm256_slli_epi64 (biased, 52));
+        }
+    };
+
+    //only the simd part is instantiated here, see the comment at the top
+    template <typename Ops, typename SampleType>
+    int processAvx2Simd (SampleType* channelData, const SampleType* delayData, const SampleType* rmsSums,
+                         const SampleType* softAttackFactors, int numSamples, const MultiplyKernel::Settings<SampleType>& settings)
+    {
+        return MultiplyKernel::dispatch (settings, [&] (auto policy)
+        {
+            return MultiplyKernel::processSimd<Ops, decltype (policy)> (channelData, delayData, rmsSums, softAttackFactors, numSamples, settings);
+        });
+    }
+}
+
+namespace MultiplyKernel
+{
+    void processAvx2 (float* channelData, const float* delayData, const float* rmsSums,
+                      const float* softAttackFactors, int numSamples, const Settings<float>& settings)
+    {
+        const int done = processAvx2Simd<Avx2Ops> (channelData, delayData, rmsSums, softAttackFactors, numSamples, settings);
+
+        //the rest (less than 8 samples) is left to the baseline version.
+        //the compiler doesn't always clear the upper halves before that call, mixing them with sse code is really slow
+        _mm256_zeroupper();
+        if (done < numSamples)
+            processSse2 (channelData + done, delayData + done, rmsSums + done, softAttackFactors + done, numSamples - done, skip (settings, done));
+    }
+
+    void processAvx2 (double* channelData, const double* delayData, const double* rmsSums,
+                      const double* softAttackFactors, int numSamples, const Settings<double>& settings)
+    {
+        //4 doubles per register, every exponent (the generic ones too) goes through the vector ops, only the rest is left to sse2
+        const int done = processAvx2Simd<Avx2DoubleOps> (channelData, delayData, rmsSums, softAttackFactors, numSamples, settings);
+
+        _mm256_zeroupper();
+        if (done < numSamples)
+            processSse2 (channelData + done, delayData + done, rmsSums + done, softAttackFactors + done, numSamples - done, skip (settings, done));
+    }
+}
+
+#if defined (__clang__)
+ #pragma clang attribute pop
+#elif defined (__GNUC__)
+ #pragma GCC pop_options
+#endif
+
+#endif
@@ -0,0 +1,304 @@
+/*
+  ==============================================================================
+
+    MultiplyKernelImpl.h
+    Vectorized rms gain and multiply stage, instantiated once per instruction set.
+
+    An Ops struct wraps the intrinsics of one instruction set and sample type, it has to provide
+    Sample, Vec, width, load, store, set1, set1Bits, add, sub, mul, div, mulAdd, sqrt, bitAnd, bitXor,
+    lessThan, greaterThan, and for the log2/exp2 approximations clamp, floor, exponentOf, mantissaOf
+    and pow2 (2^x for integral x). The double Ops get double precision series for log2/exp2 instead
+    (see FastMath), so exponents other than 0, 0.5, 1 and 2 are as good as std::pow there, not as float.
+    Ops should live in an anonymous namespace of the including .cpp so the
+    instantiations stay local to the translation unit and its compiler flags.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <type_traits>
+#include "ExponentPolicy.h"
+#include "FastMath.h"
+#include "MultiplyKernel.h"
+
+namespace MultiplyKernel
+{
+    // coefs[0] + coefs[1] x + ... as two chains in x^2 (even and odd coefs), half the latency of plain horner
+    template <typename Ops>
+    inline typename Ops::Vec polynomialDouble (const double* coefs, int numCoefs, typename Ops::Vec x)
+    {
+        const auto x2 = Ops::mul (x, x);
+        const int lastEven = (numCoefs - 1) & ~1;
+        const int lastOdd = (numCoefs - 2) | 1;
+
+        auto even = Ops::set1 (coefs[lastEven]);
+        for (int i = lastEven - 2; i >= 0; i -= 2)
+            even = Ops::mulAdd (even, x2, Ops::set1 (coefs[i]));
+
+        auto odd = Ops::set1 (coefs[lastOdd]);
+        for (int i = lastOdd - 2; i >= 1; i -= 2)
+            odd = Ops::mulAdd (odd, x2, Ops::set1 (coefs[i]));
+
+        return Ops::mulAdd (odd, x, even);
+    }
+
+    template <typename Ops>
+    inline typename Ops::Vec simdLog2Double (typename Ops::Vec x)
+    {
+        //a mantissa above sqrt(2) gets halved, the series converges a lot faster around 1 (|f| < 0.172)
+        auto mantissa = Ops::mantissaOf (x);
+        const auto above = Ops::greaterThan (mantissa, Ops::set1 (1.4142135623730951));
+        mantissa = Ops::sub (mantissa, Ops::mul (mantissa, Ops::bitAnd (above, Ops::set1 (0.5))));
+        const auto exponent = Ops::add (Ops::exponentOf (x), Ops::bitAnd (above, Ops::set1 (1.0)));
+
+        const auto f = Ops::div (Ops::sub (mantissa, Ops::set1 (1.0)), Ops::add (mantissa, Ops::set1 (1.0)));
+        const auto p = polynomialDouble<Ops> (FastMath::log2DoubleCoefs, FastMath::numLog2DoubleCoefs, Ops::mul (f, f));
+        return Ops::mulAdd (p, f, exponent);
+    }
+
+    template <typename Ops>
+    inline typename Ops::Vec simdExp2Double (typename Ops::Vec x)
+    {
+        x = Ops::clamp (x, Ops::set1 (FastMath::exp2DoubleMin), Ops::set1 (FastMath::exp2DoubleMax));
+
+        //rounded to the nearest integer, the rest is in [-0.5, 0.5]
+        const auto rounded = Ops::floor (Ops::add (x, Ops::set1 (0.5)));
+        const auto rest = Ops::sub (x, rounded);
+
+        const auto p = polynomialDouble<Ops> (FastMath::exp2DoubleCoefs, FastMath::numExp2DoubleCoefs, rest);
+        return Ops::mul (Ops::pow2 (rounded), p);
+    }
+
+    template <typename Ops>
+    inline typename Ops::Vec simdLog2 (typename Ops::Vec x)
+    {
+        if constexpr (std::is_same<typename Ops::Sample, double>::value)
+            return simdLog2Double<Ops> (x);
+
+        const auto mantissa = Ops::mantissaOf (x);
+
+        auto p = Ops::set1 (FastMath::log2Coefs[5]);
+        for (int i = 4; i >= 0; i--)
+            p = Ops::mulAdd (p, mantissa, Ops::set1 (FastMath::log2Coefs[i]));
+
+        return Ops::mulAdd (p, Ops::sub (mantissa, Ops::set1 (1.0f)), Ops::exponentOf (x));
+    }
+
+    template <typename Ops>
+    inline typename Ops::Vec simdExp2 (typename Ops::Vec x)
+    {
+        if constexpr (std::is_same<typename Ops::Sample, double>::value)
+            return simdExp2Double<Ops> (x);
+
+        x = Ops::clamp (x, Ops::set1 (FastMath::exp2Min), Ops::set1 (FastMath::exp2Max));
+
+        const auto floored = Ops::floor (x);
+        const auto fpart = Ops::sub (x, floored);
+
+        auto p = Ops::set1 (FastMath::exp2Coefs[5]);
+        for (int i = 4; i >= 0; i--)
+            p = Ops::mulAdd (p, fpart, Ops::set1 (FastMath::exp2Coefs[i]));
+
+        return Ops::mul (Ops::pow2 (floored), p);
+    }
+
+    // |delayed|^exp for a whole register, one overload per exponent policy
+    template <typename Ops>
+    inline typename Ops::Vec applyExponent (ExponentPolicy::Zero, typename Ops::Vec, typename Ops::Vec)
+    {
+        return Ops::set1 (1);
+    }
+
+    template <typename Ops>
+    inline typename Ops::Vec applyExponent (ExponentPolicy::Sqrt, typename Ops::Vec absDelayed, typename Ops::Vec)
+    {
+        return Ops::sqrt (absDelayed);
+    }
+
+    template <typename Ops>
+    inline typename Ops::Vec applyExponent (ExponentPolicy::Identity, typename Ops::Vec absDelayed, typename Ops::Vec)
+    {
+        return absDelayed;
+    }
+
+    template <typename Ops>
+    inline typename Ops::Vec applyExponent (ExponentPolicy::Square, typename Ops::Vec absDelayed, typename Ops::Vec)
+    {
+        return Ops::mul (absDelayed, absDelayed);
+    }
+
+    template <typename Ops>
+    inline typename Ops::Vec applyExponent (ExponentPolicy::Generic, typename Ops::Vec absDelayed, typename Ops::Vec exponent)
+    {
+        //pow(0, e) has to stay 0 (e == 0 goes to the Zero policy)
+        const auto powered = simdExp2<Ops> (Ops::mul (exponent, simdLog2<Ops> (absDelayed)));
+        return Ops::bitAnd (powered, Ops::greaterThan (absDelayed, Ops::set1 (0.0f)));
+    }
+
+    // scalar version for the samples that don't fill a register, double takes std::pow
+    template <typename Policy, typename SampleType>
+    inline SampleType applyExponentScalar (SampleType absDelayed, SampleType exponent)
+    {
+        if constexpr (std::is_same<Policy, ExponentPolicy::Generic>::value && std::is_same<SampleType, double>::value)
+            return std::pow (absDelayed, exponent);
+        else if constexpr (std::is_same<Policy, ExponentPolicy::Generic>::value)
+            return static_cast<SampleType> (FastMath::fastPow (static_cast<float> (absDelayed), static_cast<float> (exponent)));
+        else
+            return Policy::apply (absDelayed, exponent);
+    }
+
+    //==============================================================================
+    // (rmsSum * normalisation)^(-exp/2) for a whole register, x is the normalised sum
+    template <typename Ops>
+    inline typename Ops::Vec inverseRmsPower (ExponentPolicy::Zero, typename Ops::Vec, typename Ops::Vec)
+    {
+        return Ops::set1 (1);
+    }
+
+    template <typename Ops>
+    inline typename Ops::Vec inverseRmsPower (ExponentPolicy::Sqrt, typename Ops::Vec x, typename Ops::Vec)
+    {
+        return Ops::div (Ops::set1 (1), Ops::sqrt (Ops::sqrt (x)));
+    }
+
+    template <typename Ops>
+    inline typename Ops::Vec inverseRmsPower (ExponentPolicy::Identity, typename Ops::Vec x, typename Ops::Vec)
+    {
+        return Ops::div (Ops::set1 (1), Ops::sqrt (x));
+    }
+
+    template <typename Ops>
+    inline typename Ops::Vec inverseRmsPower (ExponentPolicy::Square, typename Ops::Vec x, typename Ops::Vec)
+    {
+        return Ops::div (Ops::set1 (1), x);
+    }
+
+    template <typename Ops>
+    inline typename Ops::Vec inverseRmsPower (ExponentPolicy::Generic, typename Ops::Vec x, typename Ops::Vec minusHalfExponent)
+    {
+        return simdExp2<Ops> (Ops::mul (minusHalfExponent, simdLog2<Ops> (x)));
+    }
+
+    template <typename Policy, typename SampleType>
+    inline SampleType inverseRmsPowerScalar (SampleType x, SampleType exponent)
+    {
+        if constexpr (std::is_same<Policy, ExponentPolicy::Generic>::value && std::is_same<SampleType, double>::value)
+            return std::pow (x, SampleType (-0.5) * exponent);
+        else if constexpr (std::is_same<Policy, ExponentPolicy::Generic>::value)
+            return static_cast<SampleType> (FastMath::fastExp2 (-0.5f * static_cast<float> (exponent) * FastMath::fastLog2 (static_cast<float> (x))));
+        else
+            return SampleType (1) / Policy::apply (std::sqrt (x), exponent);
+    }
+
+    //==============================================================================
+    // ExponentPolicy::dispatch for a block, a ramping exp is always generic
+    template <typename SampleType, typename Function>
+    inline auto dispatch (const Settings<SampleType>& settings, Function&& function)
+    {
+        if (settings.exponentStep != 0)
+            return function (ExponentPolicy::Generic());
+
+        return ExponentPolicy::dispatch (settings.exponent, function);
+    }
+
+    // the settings for the rest of the block after the first numSamples.
+    // it doesn't depend on the Ops, so it's local to every translation unit like them (see MultiplyKernelAvx2.cpp)
+    namespace
+    {
+        template <typename SampleType>
+        inline Settings<SampleType> skip (const Settings<SampleType>& settings, int numSamples)
+        {
+            auto rest = settings;
+            rest.exponent += static_cast<SampleType> (numSamples) * settings.exponentStep;
+            return rest;
+        }
+    }
+
+    // processes numSamples rounded down to a multiple of Ops::width, returns how many were done
+    template <typename Ops, typename Policy, typename SampleType = typename Ops::Sample>
+    inline int processSimd (SampleType* channelData, const SampleType* delayData, const SampleType* rmsSums,
+                            const SampleType* softAttackFactors, int numSamples, const Settings<SampleType>& settings)
+    {
+        const auto zero = Ops::set1 (0);
+        const auto signBit = Ops::set1 (SampleType (-0.0));
+        const auto allBits = Ops::set1Bits (-1);
+        const auto absMask = Ops::bitXor (signBit, allBits);
+        auto vExponent = Ops::set1 (settings.exponent);
+        auto minusHalfExponent = Ops::set1 (SampleType (-0.5) * settings.exponent);
+        const auto vUserVol = Ops::set1 (settings.userVol);
+        const auto vNormalisation = Ops::set1 (settings.rmsNormalisation);
+        const auto vThreshold = Ops::set1 (settings.rmsThreshold);
+
+        //a ramping exp gets its own value in every lane, from the sample index instead of summing up the steps
+        const bool ramping = std::is_same<Policy, ExponentPolicy::Generic>::value && settings.exponentStep != 0;
+        SampleType laneIndices[Ops::width];
+        for (int lane = 0; lane < Ops::width; lane++)
+            laneIndices[lane] = static_cast<SampleType> (lane);
+        const auto vLaneIndices = Ops::load (laneIndices);
+        const auto vExponentStep = Ops::set1 (settings.exponentStep);
+        const auto vFirstExponent = Ops::set1 (settings.exponent);
+
+        int sample = 0;
+        for (; sample + Ops::width <= numSamples; sample += Ops::width)
+        {
+            if (ramping)
+            {
+                const auto indices = Ops::add (vLaneIndices, Ops::set1 (static_cast<SampleType> (sample)));
+                vExponent = Ops::mulAdd (indices, vExponentStep, vFirstExponent);
+                minusHalfExponent = Ops::mul (vExponent, Ops::set1 (SampleType (-0.5)));
+            }
+
+            //gain from the rms, too quiet gives 0 instead of a near inf factor (this also clears the inf/nan of a 0 sum)
+            const auto sum = Ops::load (rmsSums + sample);
+            const auto loudEnough = Ops::bitXor (Ops::lessThan (sum, vThreshold), allBits);
+            const auto rmsGain = inverseRmsPower<Ops> (Policy(), Ops::mul (sum, vNormalisation), minusHalfExponent);
+            const auto gain = Ops::bitAnd (Ops::mul (Ops::load (softAttackFactors + sample), rmsGain), loudEnough);
+
+            const auto in = Ops::load (channelData + sample);
+            const auto delayed = Ops::load (delayData + sample);
+            const auto powered = applyExponent<Ops> (Policy(), Ops::bitAnd (delayed, absMask), vExponent);
+
+            //same sign handling as the reference: negate where in*delayed < 0
+            const auto negate = Ops::bitAnd (Ops::lessThan (Ops::mul (in, delayed), zero), signBit);
+
+            auto out = Ops::mul (Ops::mul (in, powered), Ops::mul (gain, vUserVol));
+            Ops::store (channelData + sample, Ops::bitXor (out, negate));
+        }
+
+        return sample;
+    }
+
+    template <typename Policy, typename SampleType>
+    inline void processScalarTail (SampleType* channelData, const SampleType* delayData, const SampleType* rmsSums,
+                                   const SampleType* softAttackFactors, int numSamples, const Settings<SampleType>& settings)
+    {
+        for (int sample = 0; sample < numSamples; sample++)
+        {
+            const SampleType exponent = settings.exponent + static_cast<SampleType> (sample) * settings.exponentStep;
+            const SampleType gain = rmsSums[sample] < settings.rmsThreshold
+                                      ? SampleType (0)
+                                      : softAttackFactors[sample] * inverseRmsPowerScalar<Policy> (rmsSums[sample] * settings.rmsNormalisation, exponent);
+
+            const SampleType delaySample = delayData[sample];
+            const SampleType negative = channelData[sample] * delaySample < 0 ? SampleType (-1) : SampleType (1);
+
+            channelData[sample] = channelData[sample] * applyExponentScalar<Policy> (std::abs (delaySample), exponent) * gain * settings.userVol * negative;
+        }
+    }
+
+    // whole block: simd part, then the rest with the scalar version of the same policy
+    template <typename Ops, typename SampleType = typename Ops::Sample>
+    inline void processBlock (SampleType* channelData, const SampleType* delayData, const SampleType* rmsSums,
+                              const SampleType* softAttackFactors, int numSamples, const Settings<SampleType>& settings)
+    {
+        dispatch (settings, [&] (auto policy)
+        {
+            using Policy = decltype (policy);
+
+            const int done = processSimd<Ops, Policy> (channelData, delayData, rmsSums, softAttackFactors, numSamples, settings);
+            processScalarTail<Policy> (channelData + done, delayData + done, rmsSums + done, softAttackFactors + done, numSamples - done,
+                                       skip (settings, done));
+        });
+    }
+}
@@ -0,0 +1,358 @@
+/*
+  ==============================================================================
+
+    Oversampler.h
+    2x, 4x or 8x oversampling for the kernel's multiply stage, from cascaded 2x
+    stages. Every stage is a linear phase half-band FIR (kaiser windowed sinc,
+    about 80dB down): all of its taps at even distances from the center are 0
+    and the center is 1/2, so up and down each split into a pure delay and a
+    short symmetric filter at the lower rate (polyphase), sideTaps multiply-adds
+    per low rate sample. The inner loops run over whole blocks, so they vectorize.
+
+    The first stage is long (the transition band sits right around the base
+    rate's nyquist), the later ones only have to keep what folds back below it
+    away and are a lot shorter. Up and down of a stage together delay by
+    2 * sideTaps - 1 samples at its lower rate, the product gets padded at the
+    top rate so the whole round trip is a whole number of base rate samples.
+
+    Every channel has upStreamsPerChannel signals going up (the input and the
+    delayed signal) and one coming down (their product). Slow signals like a
+    gain don't need the filters: hold() repeats every sample factor times and
+    delays it as much as up() does, heldStreamsPerChannel of them per channel.
+    SampleType is float or double.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+template <typename SampleType>
+class Oversampler
+{
+public:
+    static constexpr int maxFactor = 8;
+    static constexpr int upStreamsPerChannel = 2;
+    static constexpr int heldStreamsPerChannel = 2;
+
+    // factor 2, 4 or 8, blocks of at most newMaxBlockSize base rate samples
+    void prepare (int newFactor, int newNumChannels, int newMaxBlockSize)
+    {
+        factor = std::max (1, std::min (newFactor, maxFactor));
+        numChannels = newNumChannels;
+        maxBlockSize = std::max (newMaxBlockSize, 1);
+
+        stages.clear();
+        for (int rate = 1; rate < factor; rate *= 2)
+        {
+            Stage stage;
+            stage.sideTaps = getSideTaps (static_cast<int> (stages.size()));
+            stage.coefficients = design (stage.sideTaps);
+
+            const size_t history = static_cast<size_t> (2 * stage.sideTaps - 1);
+            stage.upHistory.assign (static_cast<size_t> (numChannels * upStreamsPerChannel) * history, SampleType (0));
+            stage.downEvenHistory.assign (static_cast<size_t> (numChannels) * history, SampleType (0));
+            stage.downOddHistory.assign (static_cast<size_t> (numChannels * stage.sideTaps), SampleType (0));
+            stages.push_back (std::move (stage));
+        }
+
+        padding = getPadding (factor);
+        padHistory.assign (static_cast<size_t> (numChannels * padding), SampleType (0));
+
+        holdDelay = getDelayAtTopRate (factor) / 2;
+        holdHistory.assign (static_cast<size_t> (numChannels * heldStreamsPerChannel * holdDelay), SampleType (0));
+        holdBuffer.assign (holdDelay > 0 ? static_cast<size_t> (maxBlockSize * factor + holdDelay) : 0, SampleType (0));
+
+        //the widest stage input plus the history in front of it
+        const int maxSideTaps = getSideTaps (0);
+        const size_t workSize = static_cast<size_t> (maxBlockSize * factor + 2 * maxSideTaps + padding);
+        work.assign (workSize, SampleType (0));
+        workOdd.assign (workSize, SampleType (0));
+        evenOutput.assign (workSize, SampleType (0));
+        pingPong[0].assign (static_cast<size_t> (maxBlockSize * factor), SampleType (0));
+        pingPong[1].assign (static_cast<size_t> (maxBlockSize * factor), SampleType (0));
+        paddedInput.assign (padding > 0 ? static_cast<size_t> (maxBlockSize * factor) : 0, SampleType (0));
+
+        for (auto& buffer : buffers)
+            buffer.assign (static_cast<size_t> (maxBlockSize * factor), SampleType (0));
+    }
+
+    void reset()
+    {
+        for (int channel = 0; channel < numChannels; channel++)
+            resetChannel (channel);
+    }
+
+    void resetChannel (int channel)
+    {
+        for (auto& stage : stages)
+        {
+            const int history = 2 * stage.sideTaps - 1;
+            std::fill_n (stage.upHistory.begin() + channel * upStreamsPerChannel * history, upStreamsPerChannel * history, SampleType (0));
+            std::fill_n (stage.downEvenHistory.begin() + channel * history, history, SampleType (0));
+            std::fill_n (stage.downOddHistory.begin() + channel * stage.sideTaps, stage.sideTaps, SampleType (0));
+        }
+
+        std::fill_n (padHistory.begin() + channel * padding, padding, SampleType (0));
+        std::fill_n (holdHistory.begin() + channel * heldStreamsPerChannel * holdDelay, heldStreamsPerChannel * holdDelay, SampleType (0));
+    }
+
+    int getFactor() const           { return factor; }
+    int getNumChannels() const      { return numChannels; }
+    int getMaxBlockSize() const     { return maxBlockSize; }
+
+    // of the up and down round trip, in base rate samples
+    int getLatency() const          { return getLatency (factor); }
+
+    static int getLatency (int factor)
+    {
+        return (getDelayAtTopRate (factor) + getPadding (factor)) / std::max (factor, 1);
+    }
+
+    // numSamples (at most the max block size) base rate samples of one of a channel's signals
+    // in, numSamples * factor out
+    void up (int channel, int stream, const SampleType* input, SampleType* output, int numSamples)
+    {
+        const SampleType* in = input;
+        int num = numSamples;
+
+        for (size_t s = 0; s < stages.size(); s++)
+        {
+            SampleType* out = s + 1 == stages.size() ? output : pingPong[s % 2].data();
+            auto& stage = stages[s];
+            const int history = 2 * stage.sideTaps - 1;
+            upStage (stage, stage.upHistory.data() + (channel * upStreamsPerChannel + stream) * history, in, out, num);
+            in = out;
+            num *= 2;
+        }
+    }
+
+    // like up(), but every sample is only repeated factor times (so it starts as late as up()'s output)
+    void hold (int channel, int stream, const SampleType* input, SampleType* output, int numSamples)
+    {
+        const int num = numSamples * factor;
+        SampleType* held = holdDelay > 0 ? holdBuffer.data() : output;
+        SampleType* history = holdHistory.data() + (channel * heldStreamsPerChannel + stream) * holdDelay;
+
+        std::copy (history, history + holdDelay, held);
+        for (int n = 0; n < numSamples; n++)
+            std::fill_n (held + holdDelay + n * factor, factor, input[n]);
+
+        if (holdDelay > 0)
+        {
+            std::copy (held, held + num, output);
+            std::copy (held + num, held + num + holdDelay, history);
+        }
+    }
+
+    // numSamples * factor samples at the top rate in, numSamples out
+    void down (int channel, const SampleType* input, SampleType* output, int numSamples)
+    {
+        int num = numSamples * factor;
+        const SampleType* in = input;
+
+        if (padding > 0)
+        {
+            //delays the whole round trip to a whole base rate sample
+            SampleType* pad = padHistory.data() + channel * padding;
+            SampleType* padded = paddedInput.data();
+            std::copy (pad, pad + padding, padded);
+            std::copy (input, input + num - padding, padded + padding);
+            std::copy (input + num - padding, input + num, pad);
+            in = padded;
+        }
+
+        for (size_t s = stages.size(); s-- > 0;)
+        {
+            num /= 2;
+            SampleType* out = s == 0 ? output : pingPong[s % 2].data();
+            auto& stage = stages[s];
+            const int history = 2 * stage.sideTaps - 1;
+            downStage (stage, stage.downEvenHistory.data() + channel * history,
+                       stage.downOddHistory.data() + channel * stage.sideTaps, in, out, num);
+            in = out;
+        }
+    }
+
+    // scratch for the caller, numBuffers of maxBlockSize * factor samples
+    static constexpr int numBuffers = 4;
+    SampleType* getBuffer (int index)       { return buffers[index].data(); }
+
+    size_t getMemoryUsageInBytes() const
+    {
+        size_t values = work.size() + workOdd.size() + evenOutput.size() + pingPong[0].size() + pingPong[1].size()
+                      + paddedInput.size() + padHistory.size() + holdHistory.size() + holdBuffer.size();
+        for (auto& buffer : buffers)
+            values += buffer.size();
+
+        for (auto& stage : stages)
+            values += stage.coefficients.size() + stage.upHistory.size() + stage.downEvenHistory.size() + stage.downOddHistory.size();
+
+        return values * sizeof (SampleType);
+    }
+
+private:
+    struct Stage
+    {
+        int sideTaps = 0;
+        std::vector<SampleType> coefficients; //the taps at odd distances from the center, nearest first
+        std::vector<SampleType> upHistory, downEvenHistory, downOddHistory;
+    };
+
+    // per stage, the first one (next to the base rate) needs the steep one
+    static int getSideTaps (int stageIndex)
+    {
+        static constexpr int sideTaps[] = { 24, 8, 6 };
+        return sideTaps[std::min (stageIndex, 2)];
+    }
+
+    static int getDelayAtTopRate (int factor)
+    {
+        int delay = 0;
+        for (int rate = 1, s = 0; rate < factor; rate *= 2, s++)
+            delay += (2 * getSideTaps (s) - 1) * (factor / rate);
+
+        return delay;
+    }
+
+    static int getPadding (int factor)
+    {
+        factor = std::max (factor, 1);
+        return (factor - getDelayAtTopRate (factor) % factor) % factor;
+    }
+
+    static std::vector<SampleType> design (int sideTaps)
+    {
+        //kaiser window, beta 8 is about 80dB
+        const double beta = 8.0;
+        const double center = 2 * sideTaps - 1;
+
+        auto besselI0 = [] (double x)
+        {
+            double sum = 1, term = 1;
+            for (int k = 1; k < 50; k++)
+            {
+                term *= (x / (2 * k)) * (x / (2 * k));
+                sum += term;
+            }
+            return sum;
+        };
+
+        std::vector<double> taps (static_cast<size_t> (sideTaps));
+        double sum = 0;
+        for (int j = 0; j < sideTaps; j++)
+        {
+            const double distance = 2 * j + 1;
+            const double x = distance / 2.0 * 3.14159265358979323846;
+            const double ratio = distance / (center + 1);
+            taps[static_cast<size_t> (j)] = 0.5 * std::sin (x) / x * besselI0 (beta * std::sqrt (1.0 - ratio * ratio)) / besselI0 (beta);
+            sum += taps[static_cast<size_t> (j)];
+        }
+
+        //both sides together 1/2, so dc goes through at 1 with the center tap
+        std::vector<SampleType> coefficients;
+        for (auto tap : taps)
+            coefficients.push_back (static_cast<SampleType> (tap * 0.25 / sum));
+
+        return coefficients;
+    }
+
+    // output[n] += gain * sum (a_j * (x[n + K + j] + x[n + K - 1 - j])), four taps per pass over the block
+    // so the output isn't loaded and stored for every tap
+    static void symmetricFir (const Stage& stage, const SampleType* x, SampleType* output, int numSamples, SampleType gain)
+    {
+        const int sideTaps = stage.sideTaps;
+        const SampleType* a = stage.coefficients.data();
+        int j = 0;
+
+        for (; j + 4 <= sideTaps; j += 4)
+        {
+            const SampleType a0 = gain * a[j], a1 = gain * a[j + 1], a2 = gain * a[j + 2], a3 = gain * a[j + 3];
+            const SampleType* newer = x + sideTaps + j;
+            const SampleType* older = x + sideTaps - 1 - j;
+
+            for (int n = 0; n < numSamples; n++)
+                output[n] += a0 * (newer[n] + older[n]) + a1 * (newer[n + 1] + older[n - 1])
+                           + a2 * (newer[n + 2] + older[n - 2]) + a3 * (newer[n + 3] + older[n - 3]);
+        }
+
+        for (; j < sideTaps; j++)
+        {
+            const SampleType aj = gain * a[j];
+            const SampleType* newer = x + sideTaps + j;
+            const SampleType* older = x + sideTaps - 1 - j;
+
+            for (int n = 0; n < numSamples; n++)
+                output[n] += aj * (newer[n] + older[n]);
+        }
+    }
+
+    // out[2n] = 2 * sum (a_j * (x[n - K + 1 + j] + x[n - K - j])), out[2n + 1] = x[n - K + 1]
+    void upStage (Stage& stage, SampleType* history, const SampleType* input, SampleType* output, int numSamples)
+    {
+        const int sideTaps = stage.sideTaps;
+        const int historyLength = 2 * sideTaps - 1;
+
+        SampleType* x = work.data();
+        std::copy (history, history + historyLength, x);
+        std::copy (input, input + numSamples, x + historyLength);
+
+        SampleType* even = evenOutput.data();
+        std::fill (even, even + numSamples, SampleType (0));
+
+        symmetricFir (stage, x, even, numSamples, SampleType (2));
+
+        const SampleType* middle = x + sideTaps;
+        for (int n = 0; n < numSamples; n++)
+        {
+            output[2 * n] = even[n];
+            output[2 * n + 1] = middle[n];
+        }
+
+        std::copy (x + numSamples, x + numSamples + historyLength, history);
+    }
+
+    // the same filter on the even samples and the delayed center tap on the odd ones:
+    // out[n] = 1/2 * odd[n - K] + sum (a_j * (even[n - K + 1 + j] + even[n - K - j]))
+    void downStage (Stage& stage, SampleType* evenHistory, SampleType* oddHistory,
+                    const SampleType* input, SampleType* output, int numSamples)
+    {
+        const int sideTaps = stage.sideTaps;
+        const int historyLength = 2 * sideTaps - 1;
+
+        SampleType* even = work.data();
+        SampleType* odd = workOdd.data();
+        std::copy (evenHistory, evenHistory + historyLength, even);
+        std::copy (oddHistory, oddHistory + sideTaps, odd);
+
+        for (int n = 0; n < numSamples; n++)
+        {
+            even[historyLength + n] = input[2 * n];
+            odd[sideTaps + n] = input[2 * n + 1];
+        }
+
+        for (int n = 0; n < numSamples; n++)
+            output[n] = SampleType (0.5) * odd[n];
+
+        symmetricFir (stage, even, output, numSamples, SampleType (1));
+
+        std::copy (even + numSamples, even + numSamples + historyLength, evenHistory);
+        std::copy (odd + numSamples, odd + numSamples + sideTaps, oddHistory);
+    }
+
+    int factor = 1;
+    int numChannels = 0;
+    int maxBlockSize = 0;
+    int padding = 0;
+    int holdDelay = 0; //of up() at the top rate
+
+    std::vector<Stage> stages;
+    std::vector<SampleType> padHistory, paddedInput;
+    std::vector<SampleType> holdHistory, holdBuffer;
+    std::vector<SampleType> work, workOdd, evenOutput;
+    std::vector<SampleType> pingPong[2];
+    std::vector<SampleType> buffers[numBuffers];
+};
@@ -0,0 +1,79 @@
+/*
+  ==============================================================================
+
+    PendingSwap.h
+    Hands an object built on the message thread to the audio thread with one
+    atomic pointer swap, and the replaced one back to be deleted there.
+
+    The message thread posts a new object (allocating is fine there), the audio
+    thread installs it whenever it's ready and never allocates, frees or waits.
+    The object it replaced goes to the retired slot until the message thread
+    collects it, a new one is only installed when that slot is empty again.
+    No JUCE in here.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+
+template <typename T>
+class PendingSwap
+{
+public:
+    PendingSwap() = default;
+
+    ~PendingSwap()
+    {
+        delete pending.exchange (nullptr);
+        delete retired.exchange (nullptr);
+        delete current;
+    }
+
+    // message thread: replaces whatever wasn't picked up yet
+    void post (std::unique_ptr<T> object)
+    {
+        collectGarbage();
+        std::unique_ptr<T> notPickedUp (pending.exchange (object.release(), std::memory_order_acq_rel));
+    }
+
+    // message thread: deletes what the audio thread replaced
+    void collectGarbage()
+    {
+        std::unique_ptr<T> old (retired.exchange (nullptr, std::memory_order_acq_rel));
+    }
+
+    // audio thread: whether swap() would install something right now
+    bool canSwap() const
+    {
+        return pending.load (std::memory_order_acquire) != nullptr && retired.load (std::memory_order_acquire) == nullptr;
+    }
+
+    // audio thread: installs the pending object, returns false if there's none (or the last one isn't collected yet)
+    bool swap()
+    {
+        if (retired.load (std::memory_order_acquire) != nullptr)
+            return false;
+
+        T* next = pending.exchange (nullptr, std::memory_order_acq_rel);
+        if (next == nullptr)
+            return false;
+
+        retired.store (current, std::memory_order_release);
+        current = next;
+        return true;
+    }
+
+    // audio thread (or while it isn't running)
+    const T* get() const    { return current; }
+
+private:
+    std::atomic<T*> pending { nullptr };
+    std::atomic<T*> retired { nullptr };
+    T* current = nullptr;
+
+    PendingSwap (const PendingSwap&) = delete;
+    PendingSwap& operator= (const PendingSwap&) = delete;
+};
@@ -15,15 +15,11 @@ SelfMultAudioProcessorEditor::SelfMultAudioProcessorEditor (SelfMultAudioProcess
 {
     // Make sure that before the constructor has finished, you've set the
     // editor's size to whatever you need it to be.
-    setSize (400, 300);
+    setSize (640, mainHeight + profilerHeight);
 
     delaySlider.setSliderStyle(juce::Slider::RotaryHorizontalVerticalDrag);
-    delaySlider.setRange(0.0, 50.0);
-    delaySlider.setSkewFactor(0.35);
     delaySlider.setTextBoxStyle(juce::Slider::TextBoxBelow, true, 40, 20);
-    delaySlider.setValue(0.0);
-
-    delaySlider.addListener(this);
+    delayAttachment = std::make_unique<SliderAttachment>(audioProcessor.parameters, SelfMultAudioProcessor::delayId, delaySlider);
     addAndMakeVisible(&delaySlider);
 
     delayLabel.setText("d",juce::dontSendNotification);
@@ -32,12 +28,8 @@ SelfMultAudioProcessorEditor::SelfMultAudioProcessorEditor (SelfMultAudioProcess
     addAndMakeVisible(delayLabel);
 
     exponentSlider.setSliderStyle(juce::Slider::RotaryHorizontalVerticalDrag);
-    exponentSlider.setRange(0.0, 3.0);
-    exponentSlider.setSkewFactorFromMidPoint(1.0);
     exponentSlider.setTextBoxStyle(juce::Slider::TextBoxBelow, true, 40, 20);
-    exponentSlider.setValue(1.0);
-
-    exponentSlider.addListener(this);
+    exponentAttachment = std::make_unique<SliderAttachment>(audioProcessor.parameters, SelfMultAudioProcessor::exponentId, exponentSlider);
     addAndMakeVisible(&exponentSlider);
 
     exponentLabel.setText("exp", juce::dontSendNotification);
@@ -46,12 +38,8 @@ SelfMultAudioProcessorEditor::SelfMultAudioProcessorEditor (SelfMultAudioProcess
     addAndMakeVisible(exponentLabel);
 
     volSlider.setSliderStyle(juce::Slider::LinearBarVertical);
-    volSlider.setRange(0.0, 4.0, 0.0);
     volSlider.setTextBoxStyle(juce::Slider::NoTextBox, false, 90, 0);
-    volSlider.setSkewFactorFromMidPoint(1);
-    volSlider.setValue(1.0);
-
-    volSlider.addListener(this);
+    volAttachment = std::make_unique<SliderAttachment>(audioProcessor.parameters, SelfMultAudioProcessor::userVolId, volSlider);
     addAndMakeVisible(&volSlider);
 
     volLabel.setText("vol", juce::dontSendNotification);
@@ -59,6 +47,53 @@ SelfMultAudioProcessorEditor::SelfMultAudioProcessorEditor (SelfMultAudioProcess
     volLabel.setJustificationType(juce::Justification::centredBottom);
     addAndMakeVisible(volLabel);
 
+    setupChoice(interpolationBox, SelfMultAudioProcessor::interpolationId);
+    interpolationAttachment = std::make_unique<juce::AudioProcessorValueTreeState::ComboBoxAttachment>(audioProcessor.parameters, SelfMultAudioProcessor::interpolationId, interpolationBox);
+
+    interpolationLabel.setText("d interpolation", juce::dontSendNotification);
+    interpolationLabel.attachToComponent(&interpolationBox, false);
+    addAndMakeVisible(interpolationLabel);
+
+    setupChoice(oversamplingBox, SelfMultAudioProcessor::oversamplingId);
+    oversamplingAttachment = std::make_unique<juce::AudioProcessorValueTreeState::ComboBoxAttachment>(audioProcessor.parameters, SelfMultAudioProcessor::oversamplingId, oversamplingBox);
+
+    oversamplingLabel.setText("oversampling", juce::dontSendNotification);
+    oversamplingLabel.attachToComponent(&oversamplingBox, false);
+    addAndMakeVisible(oversamplingLabel);
+
+    //lfo for d and exp
+    using ComboBoxAttachment = juce::AudioProcessorValueTreeState::ComboBoxAttachment;
+
+    setupChoice(lfoShapeBox, SelfMultAudioProcessor::lfoShapeId);
+    lfoShapeAttachment = std::make_unique<ComboBoxAttachment>(audioProcessor.parameters, SelfMultAudioProcessor::lfoShapeId, lfoShapeBox);
+
+    lfoShapeLabel.setText("lfo", juce::dontSendNotification);
+    lfoShapeLabel.attachToComponent(&lfoShapeBox, false);
+    addAndMakeVisible(lfoShapeLabel);
+
+    lfoSyncAttachment = std::make_unique<juce::AudioProcessorValueTreeState::ButtonAttachment>(audioProcessor.parameters, SelfMultAudioProcessor::lfoSyncId, lfoSyncButton);
+    addAndMakeVisible(lfoSyncButton);
+
+    setupChoice(lfoDivisionBox, SelfMultAudioProcessor::lfoDivisionId);
+    lfoDivisionAttachment = std::make_unique<ComboBoxAttachment>(audioProcessor.parameters, SelfMultAudioProcessor::lfoDivisionId, lfoDivisionBox);
+
+    setupRotary(lfoRateSlider, lfoRateLabel, "rate");
+    lfoRateAttachment = std::make_unique<SliderAttachment>(audioProcessor.parameters, SelfMultAudioProcessor::lfoRateId, lfoRateSlider);
+
+    setupRotary(lfoDelayDepthSlider, lfoDelayDepthLabel, "d depth");
+    lfoDelayDepthAttachment = std::make_unique<SliderAttachment>(audioProcessor.parameters, SelfMultAudioProcessor::lfoDelayDepthId, lfoDelayDepthSlider);
+
+    setupRotary(lfoExpDepthSlider, lfoExpDepthLabel, "exp depth");
+    lfoExpDepthAttachment = std::make_unique<SliderAttachment>(audioProcessor.parameters, SelfMultAudioProcessor::lfoExpDepthId, lfoExpDepthSlider);
+
+    setupRotary(lfoPhaseOffsetSlider, lfoPhaseOffsetLabel, "ch offset");
+    lfoPhaseOffsetAttachment = std::make_unique<SliderAttachment>(audioProcessor.parameters, SelfMultAudioProcessor::lfoPhaseOffsetId, lfoPhaseOffsetSlider);
+
+    addAndMakeVisible(meterDisplay);
+
+   #if SELFMULT_STAGE_TIMINGS
+    addAndMakeVisible(profilerPanel);
+   #endif
 
 }
 
@@ -66,6 +101,25 @@ SelfMultAudioProcessorEditor::~SelfMultAudioProcessorEditor()
 {
 }
 
+void SelfMultAudioProcessorEditor::setupRotary(juce::Slider& slider, juce::Label& label, const juce::String& text)
+{
+    slider.setSliderStyle(juce::Slider::RotaryHorizontalVerticalDrag);
+    slider.setTextBoxStyle(juce::Slider::TextBoxBelow, true, 50, 20);
+    addAndMakeVisible(&slider);
+
+    label.setText(text, juce::dontSendNotification);
+    label.attachToComponent(&slider, false);
+    label.setJustificationType(juce::Justification::centredBottom);
+    addAndMakeVisible(label);
+}
+
+void SelfMultAudioProcessorEditor::setupChoice(juce::ComboBox& box, const char* parameterId)
+{
+    //items have to be there before the attachment is created
+    box.addItemList(audioProcessor.parameters.getParameter(parameterId)->getAllValueStrings(), 1);
+    addAndMakeVisible(box);
+}
+
 //==============================================================================
 void SelfMultAudioProcessorEditor::paint (juce::Graphics& g)
 {
@@ -84,12 +138,22 @@ void SelfMultAudioProcessorEditor::resized()
 
     delaySlider.setBounds(40, 50, 80, 80);
     exponentSlider.setBounds(100, 50, 80, 80);
-    volSlider.setBounds(300, 50, 30, getHeight() - 60);
+    volSlider.setBounds(300, 50, 30, mainHeight - 60);
+    interpolationBox.setBounds(40, 180, 140, 24);
+    oversamplingBox.setBounds(195, 180, 80, 24);
+
+    lfoShapeBox.setBounds(20, 250, 100, 24);
+    lfoSyncButton.setBounds(130, 250, 60, 24);
+    lfoDivisionBox.setBounds(195, 250, 80, 24);
+    lfoRateSlider.setBounds(15, 320, 65, 80);
+    lfoDelayDepthSlider.setBounds(80, 320, 65, 80);
+    lfoExpDepthSlider.setBounds(145, 320, 65, 80);
+    lfoPhaseOffsetSlider.setBounds(210, 320, 65, 80);
+
+    meterDisplay.setBounds(350, 30, getWidth() - 370, mainHeight - 50);
+
+   #if SELFMULT_STAGE_TIMINGS
+    profilerPanel.setBounds(10, mainHeight, getWidth() - 20, profilerHeight - 10);
+   #endif
 
-}
-void SelfMultAudioProcessorEditor::sliderValueChanged(juce::Slider* slider)
-{
-    audioProcessor.delayValue = delaySlider.getValue();
-    audioProcessor.exponentValue = exponentSlider.getValue();
-    audioProcessor.userVolValue = volSlider.getValue();
 }
@@ -10,11 +10,13 @@
 
 #include <JuceHeader.h>
 #include "PluginProcessor.h"
+#include "MeterDisplay.h"
+#include "ProfilerPanel.h"
 
 //==============================================================================
 /**
 */
-class SelfMultAudioProcessorEditor  : public juce::AudioProcessorEditor, private juce::Slider::Listener
+class SelfMultAudioProcessorEditor  : public juce::AudioProcessorEditor
 {
 public:
     SelfMultAudioProcessorEditor (SelfMultAudioProcessor&);
@@ -29,14 +31,60 @@ private:
     // access the processor object that created it.
     SelfMultAudioProcessor& audioProcessor;
 
-    void sliderValueChanged(juce::Slider* slider) override;
+    using SliderAttachment = juce::AudioProcessorValueTreeState::SliderAttachment;
+
     juce::Slider delaySlider;
     juce::Label delayLabel;
     juce::Slider exponentSlider;
     juce::Label exponentLabel;
     juce::Slider volSlider;
     juce::Label volLabel;
+    juce::ComboBox interpolationBox;
+    juce::Label interpolationLabel;
+    juce::ComboBox oversamplingBox;
+    juce::Label oversamplingLabel;
+
+    juce::ComboBox lfoShapeBox;
+    juce::Label lfoShapeLabel;
+    juce::ToggleButton lfoSyncButton { "sync" };
+    juce::ComboBox lfoDivisionBox;
+    juce::Slider lfoRateSlider;
+    juce::Label lfoRateLabel;
+    juce::Slider lfoDelayDepthSlider;
+    juce::Label lfoDelayDepthLabel;
+    juce::Slider lfoExpDepthSlider;
+    juce::Label lfoExpDepthLabel;
+    juce::Slider lfoPhaseOffsetSlider;
+    juce::Label lfoPhaseOffsetLabel;
+
+    void setupRotary(juce::Slider& slider, juce::Label& label, const juce::String& text);
+    void setupChoice(juce::ComboBox& box, const char* parameterId);
+
+    //ranges, skew and values come from the parameters
+    std::unique_ptr<SliderAttachment> delayAttachment;
+    std::unique_ptr<SliderAttachment> exponentAttachment;
+    std::unique_ptr<SliderAttachment> volAttachment;
+    std::unique_ptr<juce::AudioProcessorValueTreeState::ComboBoxAttachment> interpolationAttachment;
+    std::unique_ptr<juce::AudioProcessorValueTreeState::ComboBoxAttachment> oversamplingAttachment;
+    std::unique_ptr<juce::AudioProcessorValueTreeState::ComboBoxAttachment> lfoShapeAttachment;
+    std::unique_ptr<juce::AudioProcessorValueTreeState::ButtonAttachment> lfoSyncAttachment;
+    std::unique_ptr<juce::AudioProcessorValueTreeState::ComboBoxAttachment> lfoDivisionAttachment;
+    std::unique_ptr<SliderAttachment> lfoRateAttachment;
+    std::unique_ptr<SliderAttachment> lfoDelayDepthAttachment;
+    std::unique_ptr<SliderAttachment> lfoExpDepthAttachment;
+    std::unique_ptr<SliderAttachment> lfoPhaseOffsetAttachment;
+
+    //in/out meters, rms gain trace and soft attack indicator, metering only runs while this exists
+    MeterDisplay meterDisplay { audioProcessor };
 
+    //the debug panel goes below everything else when it's compiled in
+    static constexpr int mainHeight = 420;
+   #if SELFMULT_STAGE_TIMINGS
+    static constexpr int profilerHeight = 170;
+    ProfilerPanel profilerPanel { audioProcessor };
+   #else
+    static constexpr int profilerHeight = 0;
+   #endif
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SelfMultAudioProcessorEditor)
 };
@@ -9,6 +9,37 @@
 #include "PluginProcessor.h"
 #include "PluginEditor.h"
 
+namespace
+{
+    //factory presets, parameters not listed get their default
+    struct FactoryPreset
+    {
+        const char* name;
+        std::vector<std::pair<const char*, float>> values;
+    };
+
+    const std::vector<FactoryPreset>& getFactoryPresets()
+    {
+        using P = SelfMultAudioProcessor;
+
+        static const std::vector<FactoryPreset> presets {
+            { "init",         {} },
+            { "octave fuzz",  { { P::delayId, 0.0f }, { P::exponentId, 1.0f } } },
+            { "gritty",       { { P::delayId, 1.5f }, { P::exponentId, 1.5f } } },
+            { "ring echo",    { { P::delayId, 20.0f } } },
+            { "soft sqrt",    { { P::delayId, 5.0f }, { P::exponentId, 0.5f } } },
+            { "crushed",      { { P::delayId, 0.3f }, { P::exponentId, 3.0f }, { P::userVolId, 0.7f } } },
+            { "wobble",       { { P::delayId, 8.0f }, { P::lfoRateId, 0.5f }, { P::lfoDelayDepthId, 4.0f } } },
+            { "stereo drift", { { P::delayId, 12.0f }, { P::exponentId, 1.2f }, { P::lfoShapeId, 1.0f }, { P::lfoRateId, 0.2f },
+                                { P::lfoDelayDepthId, 6.0f }, { P::lfoPhaseOffsetId, 90.0f } } },
+            { "tempo steps",  { { P::delayId, 3.0f }, { P::exponentId, 1.5f }, { P::lfoShapeId, 4.0f }, { P::lfoSyncId, 1.0f },
+                                { P::lfoDivisionId, 5.0f }, { P::lfoExpDepthId, 0.8f } } }
+        };
+
+        return presets;
+    }
+}
+
 //==============================================================================
 SelfMultAudioProcessor::SelfMultAudioProcessor()
 #ifndef JucePlugin_PreferredChannelConfigurations
@@ -19,13 +50,75 @@ SelfMultAudioProcessor::SelfMultAudioProcessor()
                       #endif
                        .withOutput ("Output", juce::AudioChannelSet::stereo(), true)
                      #endif
-                       )
+                       ),
+#else
+     :
 #endif
+       parameters (*this, nullptr, "Parameters", createParameterLayout())
 {
+    delayParameter = parameters.getRawParameterValue(delayId);
+    exponentParameter = parameters.getRawParameterValue(exponentId);
+    userVolParameter = parameters.getRawParameterValue(userVolId);
+    interpolationParameter = parameters.getRawParameterValue(interpolationId);
+    lfoShapeParameter = parameters.getRawParameterValue(lfoShapeId);
+    lfoRateParameter = parameters.getRawParameterValue(lfoRateId);
+    lfoSyncParameter = parameters.getRawParameterValue(lfoSyncId);
+    lfoDivisionParameter = parameters.getRawParameterValue(lfoDivisionId);
+    lfoDelayDepthParameter = parameters.getRawParameterValue(lfoDelayDepthId);
+    lfoExpDepthParameter = parameters.getRawParameterValue(lfoExpDepthId);
+    lfoPhaseOffsetParameter = parameters.getRawParameterValue(lfoPhaseOffsetId);
+    oversamplingParameter = parameters.getRawParameterValue(oversamplingId);
+
+    setUseReferenceKernel(false);
+
+    //rebuilds the tables when exp changed and deletes the ones the audio thread swapped out
+    startTimerHz(10);
 }
 
 SelfMultAudioProcessor::~SelfMultAudioProcessor()
 {
+    stopTimer();
+}
+
+juce::AudioProcessorValueTreeState::ParameterLayout SelfMultAudioProcessor::createParameterLayout()
+{
+    juce::NormalisableRange<float> delayRange(0.0f, 50.0f);
+    delayRange.skew = 0.35f;
+
+    juce::NormalisableRange<float> exponentRange(0.0f, maxExponent);
+    exponentRange.setSkewForCentre(1.0f);
+
+    juce::NormalisableRange<float> userVolRange(0.0f, 4.0f);
+    userVolRange.setSkewForCentre(1.0f);
+
+    juce::NormalisableRange<float> lfoRateRange(0.01f, 20.0f);
+    lfoRateRange.setSkewForCentre(1.0f);
+
+    juce::StringArray lfoDivisions;
+    for (int i = 0; i < numLfoDivisions; i++)
+        lfoDivisions.add(lfoDivisionNames[i]);
+
+    return {
+        std::make_unique<juce::AudioParameterFloat>(juce::ParameterID { delayId, 1 }, "d", delayRange, 0.0f,
+                                                    juce::AudioParameterFloatAttributes().withLabel("ms")),
+        std::make_unique<juce::AudioParameterFloat>(juce::ParameterID { exponentId, 1 }, "exp", exponentRange, 1.0f),
+        std::make_unique<juce::AudioParameterFloat>(juce::ParameterID { userVolId, 1 }, "vol", userVolRange, 1.0f),
+        std::make_unique<juce::AudioParameterChoice>(juce::ParameterID { interpolationId, 1 }, "d interpolation",
+                                                     juce::StringArray { "linear", "lagrange", "allpass" }, 0),
+        std::make_unique<juce::AudioParameterChoice>(juce::ParameterID { lfoShapeId, 1 }, "lfo shape",
+                                                     juce::StringArray { "sine", "triangle", "saw", "square", "random" }, 0),
+        std::make_unique<juce::AudioParameterFloat>(juce::ParameterID { lfoRateId, 1 }, "lfo rate", lfoRateRange, 1.0f,
+                                                    juce::AudioParameterFloatAttributes().withLabel("Hz")),
+        std::make_unique<juce::AudioParameterBool>(juce::ParameterID { lfoSyncId, 1 }, "lfo sync", false),
+        std::make_unique<juce::AudioParameterChoice>(juce::ParameterID { lfoDivisionId, 1 }, "lfo division", lfoDivisions, 4),
+        std::make_unique<juce::AudioParameterFloat>(juce::ParameterID { lfoDelayDepthId, 1 }, "lfo d depth", juce::NormalisableRange<float>(0.0f, 25.0f), 0.0f,
+                                                    juce::AudioParameterFloatAttributes().withLabel("ms")),
+        std::make_unique<juce::AudioParameterFloat>(juce::ParameterID { lfoExpDepthId, 1 }, "lfo exp depth", juce::NormalisableRange<float>(0.0f, 1.5f), 0.0f),
+        std::make_unique<juce::AudioParameterFloat>(juce::ParameterID { lfoPhaseOffsetId, 1 }, "lfo channel offset", juce::NormalisableRange<float>(0.0f, 360.0f), 0.0f,
+                                                    juce::AudioParameterFloatAttributes().withLabel("deg")),
+        std::make_unique<juce::AudioParameterChoice>(juce::ParameterID { oversamplingId, 1 }, "oversampling",
+                                                     juce::StringArray { "1x", "2x", "4x", "8x" }, 0)
+    };
 }
 
 //==============================================================================
@@ -68,26 +161,193 @@ double SelfMultAudioProcessor::getTailLengthSeconds() const
 
 int SelfMultAudioProcessor::getNumPrograms()
 {
-    return 1;   // NB: some hosts don't cope very well if you tell them there are 0 programs,
-    // so this should be at least 1, even if you're not really implementing programs.
+    return static_cast<int>(getFactoryPresets().size());
 }
 
 int SelfMultAudioProcessor::getCurrentProgram()
 {
-    return 0;
+    return currentProgram;
 }
 
 void SelfMultAudioProcessor::setCurrentProgram(int index)
 {
+    const auto& presets = getFactoryPresets();
+    if (!juce::isPositiveAndBelow(index, static_cast<int>(presets.size())))
+        return;
+
+    currentProgram = index;
+
+    //oversampling is a quality setting, presets keep it
+    juce::NamedValueSet values;
+    values.set(oversamplingId, oversamplingParameter->load());
+    for (const auto& value : presets[static_cast<size_t>(index)].values)
+        values.set(value.first, value.second);
+
+    loadValues(values);
+    updateHostDisplay(ChangeDetails().withProgramChanged(true));
 }
 
 const juce::String SelfMultAudioProcessor::getProgramName(int index)
 {
-    return {};
+    const auto& presets = getFactoryPresets();
+    return juce::isPositiveAndBelow(index, static_cast<int>(presets.size())) ? presets[static_cast<size_t>(index)].name : "";
 }
 
 void SelfMultAudioProcessor::changeProgramName(int index, const juce::String& newName)
 {
+    //factory presets keep their names
+    juce::ignoreUnused(index, newName);
+}
+
+void SelfMultAudioProcessor::loadValues(const juce::NamedValueSet& values)
+{
+    for (auto* p : getParameters())
+    {
+        if (auto* parameter = dynamic_cast<juce::RangedAudioParameter*>(p))
+        {
+            const auto* value = values.getVarPointer(parameter->paramID);
+            const float normalised = value != nullptr ? parameter->convertTo0to1(static_cast<float>(*value))
+                                                      : parameter->getDefaultValue();
+            parameter->setValueNotifyingHost(normalised);
+        }
+    }
+
+    //the audio thread installs them at the silent point of its fade
+    postDerivedTables(true);
+}
+
+void SelfMultAudioProcessor::timerCallback()
+{
+    //the new latency only applies once the audio thread installed the oversampler it comes with
+    const int latency = installedLatency.load();
+    if (latency != getLatencySamples())
+        setLatencySamples(latency);
+
+    const juce::ScopedLock lock(derivedTablesLock);
+    derivedTables.collectGarbage();
+
+    //a new oversampling factor moves the output in time, that one fades
+    if (getOversamplingFactor() != derivedTablesOversampling)
+        postDerivedTables(true);
+    //lazily, a table for every value exp passes through while it's automated would be a waste.
+    //the kernel interpolates from the grid until the new one is in
+    else if (exponentParameter->load() != derivedTablesExponent)
+        postDerivedTables(false);
+}
+
+void SelfMultAudioProcessor::postDerivedTables(bool fade)
+{
+    const juce::ScopedLock lock(derivedTablesLock);
+
+    if (fade)
+        derivedTablesFade = true;
+
+    derivedTables.post(createDerivedTables());
+}
+
+std::unique_ptr<SelfMultAudioProcessor::DerivedTables> SelfMultAudioProcessor::createDerivedTables()
+{
+    auto tables = std::make_unique<DerivedTables>();
+    derivedTablesExponent = exponentParameter->load();
+    derivedTablesOversampling = getOversamplingFactor();
+
+    if (isUsingDoublePrecision())
+        createDerivedTables<double>(tables->doubleSoftAttack, tables->doubleGrid, tables->doubleOversampler, postedDerivedTables.doubleOversampler);
+    else
+        createDerivedTables<float>(tables->floatSoftAttack, tables->floatGrid, tables->floatOversampler, postedDerivedTables.floatOversampler);
+
+    postedDerivedTables = *tables;
+    return tables;
+}
+
+template <typename SampleType>
+void SelfMultAudioProcessor::createDerivedTables(std::shared_ptr<const SoftAttackTable<SampleType>>& table,
+                                                 std::shared_ptr<const SoftAttackTableGrid<SampleType>>& grid,
+                                                 std::shared_ptr<Oversampler<SampleType>>& oversampler,
+                                                 const std::shared_ptr<Oversampler<SampleType>>& previousOversampler)
+{
+    //the window length is only known once prepared, without it the kernel computes everything itself
+    auto& dsp = getDsp<SampleType>();
+    const int windowLength = dsp.kernel.getWindowLength();
+    if (windowLength <= 0 || dsp.kernel.getNumChannels() <= 0)
+        return;
+
+    //only built if no other instance at this rate has them already, the grid doesn't depend on exp
+    //so it's also the one the tables built before used
+    auto& cache = getTableCache();
+    table = cache.getSoftAttackTable<SampleType>(windowLength, derivedTablesExponent);
+    grid = cache.getSoftAttackTableGrid<SampleType>(windowLength, maxExponent);
+
+    //the one posted before stays while only exp changes. the audio thread may be using it, so only
+    //what's fixed since it was prepared gets looked at
+    if (derivedTablesOversampling == 1)
+        return;
+
+    if (previousOversampler != nullptr && previousOversampler->getFactor() == derivedTablesOversampling
+        && previousOversampler->getNumChannels() == dsp.kernel.getNumChannels())
+    {
+        oversampler = previousOversampler;
+        return;
+    }
+
+    oversampler = std::make_shared<Oversampler<SampleType>>();
+    oversampler->prepare(derivedTablesOversampling, dsp.kernel.getNumChannels(), maxSubBlockSize);
+}
+
+template <typename SampleType>
+void SelfMultAudioProcessor::useDerivedTables()
+{
+    const auto* tables = derivedTables.get();
+
+    if constexpr (std::is_same<SampleType, double>::value)
+    {
+        doubleDsp.kernel.setSoftAttackTable(tables != nullptr ? tables->doubleSoftAttack.get() : nullptr);
+        doubleDsp.kernel.setSoftAttackTableGrid(tables != nullptr ? tables->doubleGrid.get() : nullptr);
+        doubleDsp.kernel.setOversampler(tables != nullptr ? tables->doubleOversampler.get() : nullptr);
+        installedLatency = doubleDsp.kernel.getLatencyInSamples();
+    }
+    else
+    {
+        floatDsp.kernel.setSoftAttackTable(tables != nullptr ? tables->floatSoftAttack.get() : nullptr);
+        floatDsp.kernel.setSoftAttackTableGrid(tables != nullptr ? tables->floatGrid.get() : nullptr);
+        floatDsp.kernel.setOversampler(tables != nullptr ? tables->floatOversampler.get() : nullptr);
+        installedLatency = floatDsp.kernel.getLatencyInSamples();
+    }
+}
+
+//audio thread, while faded out: installs the new tables and jumps to the new values instead of ramping there
+template <typename SampleType>
+bool SelfMultAudioProcessor::swapDerivedTables()
+{
+    if (!derivedTables.swap())
+        return false;
+
+    useDerivedTables<SampleType>();
+
+    delaySmoothed.setCurrentAndTargetValue(delayParameter->load());
+    exponentSmoothed.setCurrentAndTargetValue(exponentParameter->load());
+    userVolSmoothed.setCurrentAndTargetValue(userVolParameter->load());
+    lfoDelayDepthSmoothed.setCurrentAndTargetValue(lfoDelayDepthParameter->load());
+    lfoExpDepthSmoothed.setCurrentAndTargetValue(lfoExpDepthParameter->load());
+    return true;
+}
+
+template <typename SampleType>
+void SelfMultAudioProcessor::applyPresetFade(juce::AudioBuffer<SampleType>& buffer, int start, int numSamples)
+{
+    const float startGain = presetFadeGain;
+    const float step = static_cast<float>(numSamples) / presetFadeLength;
+
+    if (presetFade == PresetFade::fadingOut)
+        presetFadeGain = juce::jmax(0.0f, presetFadeGain - step);
+    else
+        presetFadeGain = juce::jmin(1.0f, presetFadeGain + step);
+
+    for (int channel = 0; channel < getTotalNumInputChannels(); ++channel)
+        buffer.applyGainRamp(channel, start, numSamples, static_cast<SampleType>(startGain), static_cast<SampleType>(presetFadeGain));
+
+    if (presetFade == PresetFade::fadingIn && presetFadeGain >= 1.0f)
+        presetFade = PresetFade::none;
 }
 
 //==============================================================================
@@ -96,41 +356,117 @@ void SelfMultAudioProcessor::prepareToPlay(double sampleRate, int samplesPerBloc
     // Use this method as the place to do any pre-playback
     // initialisation that you need..
 
-    int totalNumInputChannels = getTotalNumInputChannels();
-    int totalNumOutputChannels = getTotalNumOutputChannels();
+    //the host block size is only a hint, processBlock splits into maxSubBlockSize anyway
+    juce::ignoreUnused(samplesPerBlock);
 
-    //setting 0.5sec as maxDelay, should be more than enough
-    int maxDelayInSamples = 0.5 * sampleRate;
+    delaySmoothed.reset(sampleRate, 0.05);
+    exponentSmoothed.reset(sampleRate, 0.05);
+    userVolSmoothed.reset(sampleRate, 0.02);
+    delaySmoothed.setCurrentAndTargetValue(delayParameter->load());
+    exponentSmoothed.setCurrentAndTargetValue(exponentParameter->load());
+    userVolSmoothed.setCurrentAndTargetValue(userVolParameter->load());
+    lfoDelayDepthSmoothed.reset(sampleRate, 0.05);
+    lfoExpDepthSmoothed.reset(sampleRate, 0.05);
+    lfoDelayDepthSmoothed.setCurrentAndTargetValue(lfoDelayDepthParameter->load());
+    lfoExpDepthSmoothed.setCurrentAndTargetValue(lfoExpDepthParameter->load());
 
-    delayBuffer = juce::AudioBuffer<float>(totalNumInputChannels, maxDelayInSamples);
-    delayBuffer.clear();
-    delayBufferWriteIndex = 0;
+    lfo.prepare(sampleRate);
 
-    rmsWindowLength = ceil(1.0 / 60 * sampleRate); // at least 1 full wave while expecting 60Hz as lowest frequency
-    rmsBuffer = juce::AudioBuffer<float>(totalNumInputChannels, rmsWindowLength);
-    rmsBuffer.clear();
-    rmsBufferIndex = std::vector<int>(totalNumInputChannels, 0);
-    rmsSum = std::vector <float>(totalNumInputChannels, 0);
+    //longest delay the d parameter allows, the delay line rounds its ring up to a power of two
+    int maxDelayInSamples = static_cast<int>(std::ceil(parameters.getParameterRange(delayId).end / 1000.0 * sampleRate));
 
-    rmsVolumeCoefs = std::vector<std::vector<float> >(totalNumInputChannels,std::vector<float>(samplesPerBlock, 0));
+    delayValue = delaySmoothed.getCurrentValue();
+    exponentValue = exponentSmoothed.getCurrentValue();
 
-    softAttackWindowLength = rmsWindowLength;
-    softAttackWindow = std::vector<float>(softAttackWindowLength);
-    float softAttackNormalized;//from 0 to 1
-    for (int i = 0; i < softAttackWindowLength; i++)
     {
-        softAttackNormalized = static_cast<float>(i) / softAttackWindowLength;
+        //the timer can't build tables from a half prepared dsp
+        const juce::ScopedLock lock(derivedTablesLock);
+        if (shareTables)
+            privateTableCache.reset();
+        else if (privateTableCache == nullptr)
+            privateTableCache = std::make_unique<SharedTableCache>();
+
+        //the host sets the precision before calling this, so the other one can go
+        if (isUsingDoublePrecision())
+        {
+            prepareDsp<double>(sampleRate, maxDelayInSamples);
+            floatDsp = {};
+        }
+        else
+        {
+            prepareDsp<float>(sampleRate, maxDelayInSamples);
+            doubleDsp = {};
+        }
 
-        //a window i chose with start and end at 1 and rapid fall at beginning
-        softAttackWindow[i] = 1 / (100 * softAttackNormalized + 1) + 0.9901 * softAttackNormalized * softAttackNormalized;
+        //keeps the kernel choice (the benchmark sets it before preparing)
+        setUseReferenceKernel(useReferenceKernel);
+
+        //the audio thread isn't running, so tables get installed right away without a fade.
+        //a state restored before preparing didn't know the window length yet, so they're always rebuilt,
+        //with a new oversampler for the new channel count that starts silent
+        postedDerivedTables = {};
+        postDerivedTables(false);
+        derivedTables.swap();
+        derivedTables.collectGarbage();
+        derivedTablesFade = false;
+
+        if (isUsingDoublePrecision())
+            useDerivedTables<double>();
+        else
+            useDerivedTables<float>();
     }
+    setLatencySamples(installedLatency.load());
+
+    presetFade = PresetFade::none;
+    presetFadeGain = 1;
+    presetFadeLength = juce::jmax(1, juce::roundToInt(sampleRate * 0.005));
+
+    silentSamples = 0;
+    idle = false;
+    channelsToReset = 0;
+
+   #if SELFMULT_STAGE_TIMINGS
+    profiler.prepare(sampleRate, samplesPerBlock);
+   #endif
+
+    meterFrameLength = juce::jmax(1, juce::roundToInt(sampleRate / 100.0));
+    meterFrameSamples = 0;
+    pendingMeterFrame = {};
+}
+
+template <typename SampleType>
+SelfMultAudioProcessor::Dsp<SampleType>& SelfMultAudioProcessor::getDsp()
+{
+    if constexpr (std::is_same<SampleType, double>::value)
+        return doubleDsp;
+    else
+        return floatDsp;
+}
 
+template <typename SampleType>
+void SelfMultAudioProcessor::prepareDsp(double sampleRate, int maxDelayInSamples)
+{
+    int totalNumInputChannels = getTotalNumInputChannels();
+    auto& dsp = getDsp<SampleType>();
+
+    //the envelope runs at 44.1 to 88.2kHz when decimated
+    const bool decimate = envelopeMode == EnvelopeMode::decimated
+                       || (envelopeMode == EnvelopeMode::automatic && sampleRate > autoDecimationAbove);
+    const int envelopeDecimation = decimate ? juce::jmax(1, static_cast<int>(sampleRate / 44100.0)) : 1;
+
+    dsp.kernel.prepare(sampleRate, totalNumInputChannels, maxDelayInSamples, maxSubBlockSize, envelopeDecimation);
+    dsp.softAttackWindow = getTableCache().getSoftAttackWindow<SampleType>(dsp.kernel.getWindowLength());
+    dsp.kernel.setSoftAttackWindow(dsp.softAttackWindow->data());
+    dsp.kernel.setInterpolation(static_cast<DelayInterpolation>(static_cast<int>(interpolationParameter->load())));
+    updateChannelValues<SampleType>(0.0f, 0.0f);
+    dsp.kernel.reset(); //starts at the current d instead of ramping to it
 
-    softAttackProgress = std::vector<int>(totalNumInputChannels, 0);
-    softAttackMaxRise = std::vector<float>(totalNumInputChannels, 0);
-    softAttackMaxRiseIndex = std::vector<int>(totalNumInputChannels, 0);
-    softAttackInProgress = std::vector<bool>(totalNumInputChannels, false);
+    dsp.subBlockChannels = std::vector<SampleType*>(totalNumInputChannels, nullptr);
 
+    //the delay line and the rms window have to be silent before going idle, and the oversampling's filters
+    idleAfterSamples = maxDelayInSamples + dsp.kernel.getWindowLengthInSamples() + Oversampler<SampleType>::getLatency(Oversampler<SampleType>::maxFactor);
+
+    lastNumSoftAttacks = dsp.kernel.getNumSoftAttacks();
 }
 
 void SelfMultAudioProcessor::releaseResources()
@@ -146,12 +482,10 @@ bool SelfMultAudioProcessor::isBusesLayoutSupported(const BusesLayout& layouts)
     juce::ignoreUnused(layouts);
     return true;
 #else
-    // This is the place where you check if the layout is supported.
-    // In this template code we only support mono or stereo.
-    // Some plugin hosts, such as certain GarageBand versions, will only
-    // load plugins that support stereo bus layouts.
-    if (layouts.getMainOutputChannelSet() != juce::AudioChannelSet::mono()
-        && layouts.getMainOutputChannelSet() != juce::AudioChannelSet::stereo())
+    //every channel is processed on its own, so any layout (surround, ambisonics, discrete) works
+    //up to maxNumChannels
+    if (layouts.getMainOutputChannelSet().isDisabled()
+        || layouts.getMainOutputChannelSet().size() > maxNumChannels)
         return false;
 
     // This checks if the input layout matches the output layout
@@ -165,9 +499,29 @@ bool SelfMultAudioProcessor::isBusesLayoutSupported(const BusesLayout& layouts)
 }
 #endif
 
+bool SelfMultAudioProcessor::supportsDoublePrecisionProcessing() const
+{
+    return true;
+}
+
 void SelfMultAudioProcessor::processBlock(juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
 {
-    //juce::ScopedNoDenormals noDenormals;
+    juce::ignoreUnused(midiMessages);
+    processBlockImpl(buffer);
+}
+
+void SelfMultAudioProcessor::processBlock(juce::AudioBuffer<double>& buffer, juce::MidiBuffer& midiMessages)
+{
+    juce::ignoreUnused(midiMessages);
+    processBlockImpl(buffer);
+}
+
+//same code for both precisions, only the kernel (and the simd width of its multiply stage) differs
+template <typename SampleType>
+void SelfMultAudioProcessor::processBlockImpl(juce::AudioBuffer<SampleType>& buffer)
+{
+    SELFMULT_REALTIME_SCOPE;
+    juce::ScopedNoDenormals noDenormals;
     int totalNumInputChannels = getTotalNumInputChannels();
     int totalNumOutputChannels = getTotalNumOutputChannels();
 
@@ -177,199 +531,355 @@ void SelfMultAudioProcessor::processBlock(juce::AudioBuffer<float>& buffer, juce
     for (int i = totalNumInputChannels; i < totalNumOutputChannels; ++i)
         buffer.clear (i, 0, blockSize);
 
+    delaySmoothed.setTargetValue(delayParameter->load());
+    exponentSmoothed.setTargetValue(exponentParameter->load());
+    userVolSmoothed.setTargetValue(userVolParameter->load());
+
+    lfoDelayDepthSmoothed.setTargetValue(lfoDelayDepthParameter->load());
+    lfoExpDepthSmoothed.setTargetValue(lfoExpDepthParameter->load());
 
-    writeToDelayBuffer(buffer);
+    auto& dsp = getDsp<SampleType>();
+    SELFMULT_PROFILE_BLOCK(profiler, dsp.kernel.stageTimings, blockSize);
 
-    calcRmsVolumeCoefs(buffer, blockSize);
+    dsp.kernel.setInterpolation(static_cast<DelayInterpolation>(static_cast<int>(interpolationParameter->load())));
+    updateLfo();
 
-    int negative;
-    float delaySample;
-    for (int channel = 0; channel < totalNumInputChannels; ++channel)
+    //one relaxed load per block while the editor is closed
+    const bool metering = meteringEnabled.load(std::memory_order_relaxed);
+
+    if (checkIdle(buffer))
     {
-        auto* channelData = buffer.getWritePointer (channel);
-        auto* delayData = delayBuffer.getReadPointer(channel);
+        //nothing to fade while silent
+        if (swapDerivedTables<SampleType>() || presetFade != PresetFade::none)
+        {
+            derivedTablesFade = false;
+            presetFade = PresetFade::none;
+            presetFadeGain = 1;
+        }
 
-        for (int sample = 0; sample < blockSize; sample++)
+        if (metering)
         {
+            pendingMeterFrame.inputPeak = juce::jmax(pendingMeterFrame.inputPeak, getPeak(buffer.getArrayOfReadPointers(), totalNumInputChannels, blockSize));
+            advanceMeter<SampleType>(blockSize);
+        }
 
-            delaySample = delayData[delayBufferReadIndex + sample - ( (delayBufferReadIndex + sample >= delayBuffer.getNumSamples()) ) * delayBuffer.getNumSamples()];
+        for (int channel = 0; channel < totalNumInputChannels; ++channel)
+            buffer.clear(channel, 0, blockSize);
 
-            //checking if result should be negative or positive as we have to use the absolute value in the power function. (e.g. -2^2.5 cant be computed)
-            negative = channelData[sample]*delaySample < 0 ? -1 : 1;
+        delaySmoothed.skip(blockSize);
+        exponentSmoothed.skip(blockSize);
+        userVolSmoothed.skip(blockSize);
+        lfoDelayDepthSmoothed.skip(blockSize);
+        lfoExpDepthSmoothed.skip(blockSize);
+        lfo.advance(blockSize);
+        return;
+    }
 
-            channelData[sample] = channelData[sample] * pow(abs(delaySample),exponentValue) * rmsVolumeCoefs[channel][sample] * userVolValue * negative;
+    //a state or preset change: fade out, install the new tables at silence and fade back in.
+    //a new table for exp only goes in right away, the values don't jump then
+    if (presetFade == PresetFade::none && derivedTables.canSwap())
+    {
+        if (derivedTablesFade.exchange(false))
+            presetFade = PresetFade::fadingOut;
+        else if (derivedTables.swap())
+            useDerivedTables<SampleType>();
+    }
+
+    //hosts may send bigger (or varying) blocks than announced in prepareToPlay, so everything runs
+    //in sub-blocks of at most maxSubBlockSize samples, which is what the buffers are allocated for.
+    //while ramping or modulating, values are updated every smoothingSubBlockSize samples
+    const bool smoothing = delaySmoothed.isSmoothing() || exponentSmoothed.isSmoothing() || userVolSmoothed.isSmoothing()
+                        || lfoDelayDepthSmoothed.isSmoothing() || lfoExpDepthSmoothed.isSmoothing();
+    const bool modulating = lfoDelayDepthSmoothed.getTargetValue() > 0 || lfoExpDepthSmoothed.getTargetValue() > 0 || smoothing
+                         || presetFade != PresetFade::none;
+    const int subBlockSize = modulating ? smoothingSubBlockSize : maxSubBlockSize;
 
+    for (int start = 0; start < blockSize; start += subBlockSize)
+    {
+        int numSamples = juce::jmin(subBlockSize, blockSize - start);
 
+        if (presetFade == PresetFade::fadingOut && presetFadeGain <= 0.0f)
+        {
+            swapDerivedTables<SampleType>();
+            presetFade = PresetFade::fadingIn;
+        }
+
+        delayValue = delaySmoothed.skip(numSamples);
+        exponentValue = exponentSmoothed.skip(numSamples);
+        userVolValue = userVolSmoothed.skip(numSamples);
+
+        lfo.advance(numSamples);
+        updateChannelValues<SampleType>(lfoDelayDepthSmoothed.skip(numSamples), lfoExpDepthSmoothed.skip(numSamples));
+        dsp.kernel.setUserVolume(userVolValue);
+
+        //plain pointers instead of an AudioBuffer referring to the host's data, that one allocates above 32 channels
+        for (int channel = 0; channel < totalNumInputChannels; ++channel)
+            dsp.subBlockChannels[channel] = buffer.getWritePointer(channel, start);
+
+        if (metering)
+            pendingMeterFrame.inputPeak = juce::jmax(pendingMeterFrame.inputPeak, getPeak(dsp.subBlockChannels.data(), totalNumInputChannels, numSamples));
+
+        dsp.kernel.process(dsp.subBlockChannels.data(), numSamples);
+
+        if (presetFade != PresetFade::none)
+            applyPresetFade(buffer, start, numSamples);
+
+        if (metering)
+        {
+            pendingMeterFrame.outputPeak = juce::jmax(pendingMeterFrame.outputPeak, getPeak(dsp.subBlockChannels.data(), totalNumInputChannels, numSamples));
+            advanceMeter<SampleType>(numSamples);
         }
     }
 }
 
-
-void SelfMultAudioProcessor::writeToDelayBuffer(juce::AudioBuffer<float>& buffer)
+template <typename SampleType>
+float SelfMultAudioProcessor::getPeak(const SampleType* const* channels, int numChannels, int numSamples)
 {
-    int blockSize = buffer.getNumSamples();
-    bool wrap;
-    int nSamples;
-
-    int delayInSamples = delayValue / 1000.0 * getSampleRate();   // todo maybe change to float with interpolation
+    SampleType peak = 0;
 
-    delayBufferReadIndex = delayBufferWriteIndex - delayInSamples;
-    if (delayBufferReadIndex < 0)
+    for (int channel = 0; channel < numChannels; ++channel)
     {
-        delayBufferReadIndex += delayBuffer.getNumSamples();
+        auto range = juce::FloatVectorOperations::findMinAndMax(channels[channel], numSamples);
+        peak = juce::jmax(peak, -range.getStart(), range.getEnd());
     }
 
+    return static_cast<float>(peak);
+}
 
+template <typename SampleType>
+void SelfMultAudioProcessor::advanceMeter(int numSamples)
+{
+    meterFrameSamples += numSamples;
+    if (meterFrameSamples < meterFrameLength)
+        return;
 
-    //check if needing to wrap
-    if (delayBufferWriteIndex + blockSize >= delayBuffer.getNumSamples())
-    {
-        wrap = true;
-        nSamples = delayBuffer.getNumSamples() - delayBufferWriteIndex;
-    }
-    else
+    //a pow per channel every 10ms, the per sample gains aren't kept anywhere
+    auto& kernel = getDsp<SampleType>().kernel;
+    float gainSum = 0;
+    for (int channel = 0; channel < kernel.getNumChannels(); ++channel)
+        gainSum += static_cast<float>(kernel.getLastGain(channel));
+
+    pendingMeterFrame.gain = kernel.getNumChannels() > 0 ? gainSum / kernel.getNumChannels() : 0.0f;
+
+    const uint32_t numSoftAttacks = kernel.getNumSoftAttacks();
+    pendingMeterFrame.softAttack = numSoftAttacks != lastNumSoftAttacks;
+    lastNumSoftAttacks = numSoftAttacks;
+
+    meterFifo.push(pendingMeterFrame); //dropped if the editor doesn't keep up
+    pendingMeterFrame = {};
+    meterFrameSamples = 0;
+}
+
+void SelfMultAudioProcessor::updateLfo()
+{
+    lfo.setShape(static_cast<Lfo::Shape>(static_cast<int>(lfoShapeParameter->load())));
+
+    if (lfoSyncParameter->load() < 0.5f)
     {
-        wrap = false;
-        nSamples = blockSize;
+        lfo.setFrequency(lfoRateParameter->load());
+        return;
     }
 
-    for (int channel = 0; channel < buffer.getNumChannels(); channel++)
+    double beatsPerCycle = lfoDivisionBeats[juce::jlimit(0, numLfoDivisions - 1, static_cast<int>(lfoDivisionParameter->load()))];
+    double bpm = 120.0;
+
+    if (auto* playHead = getPlayHead())
     {
-        delayBuffer.copyFrom(channel, delayBufferWriteIndex, buffer.getReadPointer(channel), nSamples);
-        if (wrap)
+        if (auto position = playHead->getPosition())
         {
-            delayBuffer.copyFrom(channel, 0, buffer.getReadPointer(channel)+nSamples, blockSize-nSamples);
+            bpm = position->getBpm().orFallback(bpm);
+
+            //follow the song position while playing, otherwise just run at the tempo
+            auto ppq = position->getPpqPosition();
+            if (position->getIsPlaying() && ppq.hasValue())
+            {
+                lfo.syncToPosition(*ppq, bpm, beatsPerCycle);
+                return;
+            }
         }
     }
 
-    delayBufferWriteIndex = wrap ? blockSize - nSamples : delayBufferWriteIndex+blockSize;
+    lfo.setFrequency(bpm / 60.0 / beatsPerCycle);
 }
 
-
-
-//==============================================================================
-bool SelfMultAudioProcessor::hasEditor() const
+template <typename SampleType>
+void SelfMultAudioProcessor::updateChannelValues(float lfoDelayDepth, float lfoExpDepth)
 {
-    return true; // (change this to false if you choose to not supply an editor)
-}
+    auto& kernel = getDsp<SampleType>().kernel;
+    const float samplesPerMs = static_cast<float>(getSampleRate() / 1000.0);
+    const double phaseOffset = lfoPhaseOffsetParameter->load() / 360.0;
 
-juce::AudioProcessorEditor* SelfMultAudioProcessor::createEditor()
-{
-    return new SelfMultAudioProcessorEditor (*this);
-}
+    for (int channel = 0; channel < kernel.getNumChannels(); channel++)
+    {
+        float delay = delayValue;
+        float exponent = exponentValue;
 
-//==============================================================================
-void SelfMultAudioProcessor::getStateInformation (juce::MemoryBlock& destData)
-{
-    // You should use this method to store your parameters in the memory block.
-    // You could do that either as raw data, or use the XML or ValueTree classes
-    // as intermediaries to make it easy to save and load complex data.
-}
+        //without modulation exp stays exactly on the parameter value, so the fast paths for 0, 0.5, 1 and 2 keep working
+        if (lfoDelayDepth > 0 || lfoExpDepth > 0)
+        {
+            const float value = lfo.getValue(std::fmod(channel * phaseOffset, 1.0));
+            delay += lfoDelayDepth * value; //the delay line clamps it to its range
+            exponent = juce::jlimit(0.0f, maxExponent, exponent + lfoExpDepth * value);
+        }
 
-void SelfMultAudioProcessor::setStateInformation (const void* data, int sizeInBytes)
-{
-    // You should use this method to restore your parameters from this memory block,
-    // whose contents will have been created by the getStateInformation() call.
+        kernel.setDelay(channel, delay * samplesPerMs);
+        kernel.setExponent(channel, exponent);
+    }
 }
 
-void SelfMultAudioProcessor::calcRmsVolumeCoefs(juce::AudioBuffer<float>& input, int blockSize)
+template <typename SampleType>
+bool SelfMultAudioProcessor::checkIdle(const juce::AudioBuffer<SampleType>& buffer)
 {
-    for (int channel = 0; channel < rmsVolumeCoefs.size(); channel++)
+    int blockSize = buffer.getNumSamples();
+
+    for (int channel = 0; channel < getTotalNumInputChannels(); channel++)
     {
-        auto* channelData = input.getReadPointer(channel);
-        auto* rmsData = rmsBuffer.getWritePointer(channel);
-        float softAttackFactor;
-        for (int i = 0; i < blockSize; i++)
+        if (buffer.getMagnitude(channel, 0, blockSize) >= static_cast<SampleType>(idleThreshold))
         {
-            //sum for rms
-            rmsSum[channel] -= rmsData[rmsBufferIndex[channel]];
-            rmsData[rmsBufferIndex[channel]] = pow(channelData[i], 2);
-            rmsSum[channel] += rmsData[rmsBufferIndex[channel]];
+            silentSamples = 0;
+            idle = false;
 
-            if (!softAttackInProgress[channel]) {
-                checkSoftAttackTrigger(channel, rmsData);
-            }
+            //woke up before all channels were reset
+            while (channelsToReset > 0)
+                getDsp<SampleType>().kernel.resetChannel(--channelsToReset);
 
-            softAttackFactor = getSoftAttackFactor(channel);
-            //if volume too low return 0 to avoid having a near inf factor
-            if (rmsSum[channel] < 0.0001)
-            {
-                rmsVolumeCoefs[channel][i] = 0;
-            }
-            else
-            {
-                rmsVolumeCoefs[channel][i] = softAttackFactor / pow(std::sqrt(rmsSum[channel] / getSampleRate()) / std::sqrt(rmsWindowLength / (2 * getSampleRate())), exponentValue);
-            }
+            return false;
+        }
+    }
 
-            if (++rmsBufferIndex[channel] >= rmsWindowLength)
-            {
-                rmsBufferIndex[channel] -= rmsWindowLength;
-            }
+    //counts only the silence before this block, so the whole rms window of every sample in it is silent
+    const bool silentLongEnough = silentSamples >= idleAfterSamples;
+    silentSamples = juce::jmin(silentSamples + blockSize, idleAfterSamples);
 
-        }
+    if (!silentLongEnough)
+        return false;
 
+    if (!idle)
+    {
+        //what's in there is below the threshold anyway, starting from zeros
+        //gives the same output as running the dsp all the time would have.
+        //one channel per block, all at once takes longer than a short block at 384kHz with 16 channels
+        idle = true;
+        channelsToReset = getDsp<SampleType>().kernel.getNumChannels();
     }
 
+    if (channelsToReset > 0)
+        getDsp<SampleType>().kernel.resetChannel(--channelsToReset);
+
+    return true;
 }
 
+size_t SelfMultAudioProcessor::getMemoryFootprint() const
+{
+    const juce::ScopedLock lock(derivedTablesLock);
+    return floatDsp.kernel.getMemoryUsageInBytes() + doubleDsp.kernel.getMemoryUsageInBytes()
+         + (postedDerivedTables.floatOversampler != nullptr ? postedDerivedTables.floatOversampler->getMemoryUsageInBytes() : 0)
+         + (postedDerivedTables.doubleOversampler != nullptr ? postedDerivedTables.doubleOversampler->getMemoryUsageInBytes() : 0)
+         + (privateTableCache != nullptr ? privateTableCache->getMemoryUsageInBytes() : 0);
+}
 
-float SelfMultAudioProcessor::getSoftAttackFactor(int channel)
+void SelfMultAudioProcessor::setUseReferenceKernel(bool shouldUseReference)
 {
-    if (softAttackProgress[channel] >= softAttackWindowLength-1) {
-        softAttackInProgress[channel] = false;
+    useReferenceKernel = shouldUseReference;
+
+    if (shouldUseReference)
+    {
+        floatDsp.kernel.setMultiplyFunction(MultiplyKernel::processReference);
+        doubleDsp.kernel.setMultiplyFunction(MultiplyKernel::processReference);
+    }
+    else
+    {
+        floatDsp.kernel.setMultiplyFunction(MultiplyKernel::getBestImplementation<float>());
+        doubleDsp.kernel.setMultiplyFunction(MultiplyKernel::getBestImplementation<double>());
     }
-    return softAttackInProgress[channel] ? pow(softAttackWindow[softAttackProgress[channel]++],exponentValue) : 1;
 }
 
-void SelfMultAudioProcessor::activateSoftAttack(int channel)
+int SelfMultAudioProcessor::getOversamplingFactor() const
 {
-    if (!softAttackInProgress[channel] && rmsSum[channel]>0.0001) {
+    int factor = 1 << static_cast<int>(oversamplingParameter->load());
+    while (factor > 1 && getSampleRate() * factor > maxOversampledRate)
+        factor /= 2;
 
-        softAttackInProgress[channel] = true;
-        softAttackProgress[channel] = 0;
-    }
+    return factor;
+}
 
+int SelfMultAudioProcessor::getEnvelopeDecimation() const
+{
+    return isUsingDoublePrecision() ? doubleDsp.kernel.getEnvelopeDecimation() : floatDsp.kernel.getEnvelopeDecimation();
 }
 
-void SelfMultAudioProcessor::checkSoftAttackTrigger(int channel, float* rmsData)
+const char* SelfMultAudioProcessor::getKernelName() const
 {
-    //auto* rmsData = rmsBuffer.getReadPointer(channel);
-    float diff;
-    if (rmsBufferIndex[channel] == 0) {
-        diff = rmsData[0] - rmsData[rmsWindowLength - 1];
-    }
-    else {
-        diff = rmsData[rmsBufferIndex[channel]] - rmsData[rmsBufferIndex[channel] - 1];
-    }
+    if (isUsingDoublePrecision())
+        return MultiplyKernel::getImplementationName(doubleDsp.kernel.getMultiplyFunction());
 
-    //when maxRise got replaced by new sample find new maxRise, except new sample
-    if (rmsBufferIndex[channel] == softAttackMaxRiseIndex[channel])
-    {
-        softAttackMaxRise[channel] = 0;
-        int lastRmsIndex = rmsWindowLength - 1;
-        for (int rmsIndex = 0; rmsIndex < rmsWindowLength; rmsIndex++)
-        {
-            if (rmsIndex != rmsBufferIndex[channel] && lastRmsIndex != rmsBufferIndex[channel])
-            {
-                if (softAttackMaxRise[channel] < rmsData[rmsIndex] - rmsData[lastRmsIndex]) {
-                    softAttackMaxRise[channel] = rmsData[rmsIndex] - rmsData[lastRmsIndex];
-                }
-            }
+    return MultiplyKernel::getImplementationName(floatDsp.kernel.getMultiplyFunction());
+}
 
-            lastRmsIndex = rmsIndex;
-        }
-    }
+//==============================================================================
+bool SelfMultAudioProcessor::hasEditor() const
+{
+    return true; // (change this to false if you choose to not supply an editor)
+}
 
-    //trigger if diff from new to last sample is 2x as max in window
-    if (softAttackMaxRise[channel] * 1.5 < diff) {
-        activateSoftAttack(channel);
+juce::AudioProcessorEditor* SelfMultAudioProcessor::createEditor()
+{
+    return new SelfMultAudioProcessorEditor (*this);
+}
+
+//==============================================================================
+void SelfMultAudioProcessor::getStateInformation (juce::MemoryBlock& destData)
+{
+    juce::MemoryOutputStream stream(destData, false);
+    stream.writeInt(static_cast<int>(stateMagic));
+    stream.writeShort(static_cast<short>(stateVersion));
+    stream.writeShort(static_cast<short>(currentProgram));
+
+    juce::Array<juce::RangedAudioParameter*> rangedParameters;
+    for (auto* p : getParameters())
+        if (auto* parameter = dynamic_cast<juce::RangedAudioParameter*>(p))
+            rangedParameters.add(parameter);
+
+    //plain values, so changing a range later doesn't move old sessions
+    stream.writeShort(static_cast<short>(rangedParameters.size()));
+    for (auto* parameter : rangedParameters)
+    {
+        stream.writeString(parameter->paramID);
+        stream.writeFloat(parameter->convertFrom0to1(parameter->getValue()));
     }
+}
+
+void SelfMultAudioProcessor::setStateInformation (const void* data, int sizeInBytes)
+{
+    if (data == nullptr || sizeInBytes < 10)
+        return;
+
+    juce::MemoryInputStream stream(data, static_cast<size_t>(sizeInBytes), false);
+    if (static_cast<juce::uint32>(stream.readInt()) != stateMagic)
+        return; //not ours, keep what we have
 
-    if (softAttackMaxRise[channel] < diff) {
-        softAttackMaxRise[channel] = diff;
-        softAttackMaxRiseIndex[channel] = rmsBufferIndex[channel];
+    //newer versions only append, so everything up to the values can be read from any of them
+    const int version = stream.readShort();
+    if (version < 1)
+        return;
+
+    const int program = stream.readShort();
+    const int numValues = stream.readShort();
+
+    juce::NamedValueSet values;
+    for (int i = 0; i < numValues && !stream.isExhausted(); ++i)
+    {
+        const auto id = stream.readString();
+        if (id.isEmpty() || stream.getNumBytesRemaining() < 4)
+            break; //truncated
+
+        values.set(id, stream.readFloat());
     }
+
+    currentProgram = juce::jlimit(0, getNumPrograms() - 1, program);
+    loadValues(values);
 }
+
 /*
 
 ideas for softer Attack
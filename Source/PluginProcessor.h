@@ -9,6 +9,14 @@
 #pragma once
 
 #include <JuceHeader.h>
+#include "Lfo.h"
+#include "MeterFifo.h"
+#include "MultiplyKernel.h"
+#include "PendingSwap.h"
+#include "RealtimeCheck.h"
+#include "SelfMultKernel.h"
+#include "SharedTableCache.h"
+#include "StageProfiler.h"
 
 //==============================================================================
 /**
@@ -17,6 +25,7 @@ class SelfMultAudioProcessor  : public juce::AudioProcessor
                             #if JucePlugin_Enable_ARA
                              , public juce::AudioProcessorARAExtension
                             #endif
+                             , private juce::Timer
 {
 public:
     //==============================================================================
@@ -32,6 +41,8 @@ public:
    #endif
 
     void processBlock (juce::AudioBuffer<float>&, juce::MidiBuffer&) override;
+    void processBlock (juce::AudioBuffer<double>&, juce::MidiBuffer&) override;
+    bool supportsDoublePrecisionProcessing() const override;
 
     //==============================================================================
     juce::AudioProcessorEditor* createEditor() override;
@@ -56,36 +67,212 @@ public:
     void getStateInformation (juce::MemoryBlock& destData) override;
     void setStateInformation (const void* data, int sizeInBytes) override;
 
-    float delayValue = 0;
-    float exponentValue = 1;
-    float userVolValue = 1;
+    static constexpr const char* delayId = "delay";
+    static constexpr const char* exponentId = "exp";
+    static constexpr const char* userVolId = "vol";
+    static constexpr const char* interpolationId = "interp";
+    static constexpr const char* lfoShapeId = "lfoShape";
+    static constexpr const char* lfoRateId = "lfoRate";
+    static constexpr const char* lfoSyncId = "lfoSync";
+    static constexpr const char* lfoDivisionId = "lfoDivision";
+    static constexpr const char* lfoDelayDepthId = "lfoDelayDepth";
+    static constexpr const char* lfoExpDepthId = "lfoExpDepth";
+    static constexpr const char* lfoPhaseOffsetId = "lfoPhaseOffset";
+    static constexpr const char* oversamplingId = "oversampling";
+
+    juce::AudioProcessorValueTreeState parameters;
+
+    //state: magic, version, program, then (id, plain value) pairs. versions only ever append to that,
+    //ids that aren't known get skipped and parameters missing from the state get their default
+    static constexpr juce::uint32 stateMagic = 0x53537453; //"StSS" in the little endian stream
+    static constexpr int stateVersion = 1;
 
     float mixValue = 1; //not implemented yet
 
+    //host blocks get processed in parts of this, small enough for the scratch of a channel group to stay in L1
+    static constexpr int maxSubBlockSize = 256;
+
+    //bytes of audio data allocated in prepareToPlay (buffers and tables), without the object itself.
+    //tables shared with other instances aren't in there, they're in getSharedTableMemory() once for all of them
+    size_t getMemoryFootprint() const;
+    size_t getSharedTableMemory() const { return tableCache->getMemoryUsageInBytes(); }
+
+    //the benchmark turns this off to compare against every instance building its own tables.
+    //takes effect at the next prepareToPlay
+    void setShareTables(bool shouldShare) { shareTables = shouldShare; }
+
+    //the benchmark uses these to compare against the original pow loop
+    void setUseReferenceKernel(bool shouldUseReference);
+    const char* getKernelName() const;
+
+    //the envelope (rms window and soft attack detection) at the full rate or decimated to 44.1-88.2kHz,
+    //see SelfMultKernel. automatic decimates above 100kHz. takes effect at the next prepareToPlay
+    enum class EnvelopeMode { automatic, fullRate, decimated };
+    void setEnvelopeMode(EnvelopeMode newMode) { envelopeMode = newMode; }
+    int getEnvelopeDecimation() const;
+
+    //of the multiply stage (1, 2, 4 or 8), the rms envelope and the delay stay at the host's rate.
+    //the parameter's, but never above maxOversampledRate: 8x at 96kHz runs 4x, at 384kHz there's none
+    int getOversamplingFactor() const;
+
+    //meter frames for the editor, only fed while metering is enabled (the editor does that while it's open)
+    MeterFifo& getMeterFifo() { return meterFifo; }
+    void setMeteringEnabled(bool shouldBeEnabled) { meteringEnabled = shouldBeEnabled; }
+
+   #if SELFMULT_STAGE_TIMINGS
+    StageTimings& getStageTimings() { return isUsingDoublePrecision() ? doubleDsp.kernel.stageTimings : floatDsp.kernel.stageTimings; }
+
+    //per block histograms of the stage timings and the cpu load, for the editor's debug panel
+    StageProfiler& getProfiler() { return profiler; }
+   #endif
+
 private:
     //==============================================================================
+    static juce::AudioProcessorValueTreeState::ParameterLayout createParameterLayout();
+
+    std::atomic<float>* delayParameter = nullptr;
+    std::atomic<float>* exponentParameter = nullptr;
+    std::atomic<float>* userVolParameter = nullptr;
+    std::atomic<float>* interpolationParameter = nullptr;
+    std::atomic<float>* lfoShapeParameter = nullptr;
+    std::atomic<float>* lfoRateParameter = nullptr;
+    std::atomic<float>* lfoSyncParameter = nullptr;
+    std::atomic<float>* lfoDivisionParameter = nullptr;
+    std::atomic<float>* lfoDelayDepthParameter = nullptr;
+    std::atomic<float>* lfoExpDepthParameter = nullptr;
+    std::atomic<float>* lfoPhaseOffsetParameter = nullptr;
+    std::atomic<float>* oversamplingParameter = nullptr;
 
-    void writeToDelayBuffer(juce::AudioBuffer<float>& buffer);
-    void calcRmsVolumeCoefs(juce::AudioBuffer<float>& input, int blockSize);
-    juce::AudioBuffer<float> delayBuffer;
-    int delayBufferWriteIndex;
-    int delayBufferReadIndex;
-
-    juce::AudioBuffer<float> rmsBuffer;
-    std::vector<std::vector<float> > rmsVolumeCoefs;
-    std::vector<float> rmsSum;
-    std::vector<int> rmsBufferIndex;
-    int rmsWindowLength;
-
-    float getSoftAttackFactor(int channel);
-    void activateSoftAttack(int channel);
-    void checkSoftAttackTrigger(int channel, float* rmsData);
-    std::vector<float> softAttackWindow;
-    int softAttackWindowLength;
-    std::vector<float> softAttackMaxRise;
-    std::vector<int> softAttackMaxRiseIndex;
-    std::vector<bool> softAttackInProgress;
-    std::vector<int> softAttackProgress;
+    juce::SmoothedValue<float> delaySmoothed;
+    juce::SmoothedValue<float> exponentSmoothed;
+    juce::SmoothedValue<float> userVolSmoothed;
+    static constexpr float maxExponent = 3.0f;
+    static constexpr int smoothingSubBlockSize = 32;
+    static constexpr int maxNumChannels = 64;
+
+    //current (smoothed) values, only touched on the audio thread
+    float delayValue = 0;
+    float exponentValue = 1;
+    float userVolValue = 1;
+
+    //all the dsp, the processor only feeds it smoothed and modulated parameters sub-block by sub-block.
+    //there's one for float and one for double, only the one for the host's precision gets prepared
+    template <typename SampleType>
+    struct Dsp
+    {
+        SelfMultKernel<SelfMultMode::A, SampleType> kernel;
+        std::vector<SampleType*> subBlockChannels;
+        std::shared_ptr<const SharedTableCache::Window<SampleType>> softAttackWindow; //the kernel only points at it
+    };
+    Dsp<float> floatDsp;
+    Dsp<double> doubleDsp;
+    bool useReferenceKernel = false;
+    EnvelopeMode envelopeMode = EnvelopeMode::automatic;
+    static constexpr double autoDecimationAbove = 100000.0;
+    static constexpr double maxOversampledRate = 400000.0;
+
+    template <typename SampleType>
+    Dsp<SampleType>& getDsp();
+    template <typename SampleType>
+    void prepareDsp(double sampleRate, int maxDelayInSamples);
+    template <typename SampleType>
+    void processBlockImpl(juce::AudioBuffer<SampleType>& buffer);
+
+    //everything derived from the parameters that's too slow for the audio thread, built on the message
+    //thread and installed in one swap: after a state or preset change while the output is faded out,
+    //after exp changed (checked by the timer) right away. only the tables for the current precision are
+    //filled. they're read-only and come from the table cache, so instances at the same rate (and exp) share them.
+    //the oversampler isn't read-only, but only the audio thread uses it and every DerivedTables hands on the same
+    //one until the factor changes (a new one goes in with a fade, it starts silent and its latency is different).
+    //the dsp is prepared under derivedTablesLock too, as building them reads its window length and channel count
+    struct DerivedTables
+    {
+        std::shared_ptr<const SoftAttackTable<float>> floatSoftAttack;
+        std::shared_ptr<const SoftAttackTable<double>> doubleSoftAttack;
+        std::shared_ptr<const SoftAttackTableGrid<float>> floatGrid;
+        std::shared_ptr<const SoftAttackTableGrid<double>> doubleGrid;
+        std::shared_ptr<Oversampler<float>> floatOversampler;
+        std::shared_ptr<Oversampler<double>> doubleOversampler;
+    };
+    PendingSwap<DerivedTables> derivedTables;
+    juce::CriticalSection derivedTablesLock; //between the threads posting, never taken by the audio thread
+    std::atomic<bool> derivedTablesFade { false };
+    std::atomic<int> installedLatency { 0 }; //of the tables the audio thread installed last, the timer tells the host
+    float derivedTablesExponent = -1;
+    int derivedTablesOversampling = 1;
+    DerivedTables postedDerivedTables; //a copy of the last ones posted, where the oversampler gets handed on from
+    void postDerivedTables(bool fade);
+    std::unique_ptr<DerivedTables> createDerivedTables();
+    template <typename SampleType>
+    void createDerivedTables(std::shared_ptr<const SoftAttackTable<SampleType>>& table,
+                             std::shared_ptr<const SoftAttackTableGrid<SampleType>>& grid,
+                             std::shared_ptr<Oversampler<SampleType>>& oversampler,
+                             const std::shared_ptr<Oversampler<SampleType>>& previousOversampler);
+    template <typename SampleType>
+    void useDerivedTables();
+    template <typename SampleType>
+    bool swapDerivedTables();
+    void timerCallback() override;
+
+    //process-wide, or one of our own when not sharing (only ever touched under derivedTablesLock)
+    juce::SharedResourcePointer<SharedTableCache> tableCache;
+    std::unique_ptr<SharedTableCache> privateTableCache;
+    bool shareTables = true;
+    SharedTableCache& getTableCache() { return privateTableCache != nullptr ? *privateTableCache : *tableCache; }
+
+    //sets every parameter (the ones not in values to their default) and posts new tables
+    void loadValues(const juce::NamedValueSet& values);
+    int currentProgram = 0;
+
+    //short fade out and in around installing new tables, the parameters jump to their new values in between
+    enum class PresetFade { none, fadingOut, fadingIn };
+    PresetFade presetFade = PresetFade::none;
+    float presetFadeGain = 1;
+    int presetFadeLength = 220; //5ms, set in prepareToPlay
+    template <typename SampleType>
+    void applyPresetFade(juce::AudioBuffer<SampleType>& buffer, int start, int numSamples);
+
+    //lfo for d and exp, evaluated once per sub-block and channel
+    Lfo lfo;
+    juce::SmoothedValue<float> lfoDelayDepthSmoothed;
+    juce::SmoothedValue<float> lfoExpDepthSmoothed;
+    static constexpr int numLfoDivisions = 13;
+    static constexpr const char* lfoDivisionNames[numLfoDivisions] = { "4/1", "2/1", "1/1", "1/2", "1/4", "1/8", "1/16", "1/32",
+                                                                       "1/4T", "1/8T", "1/16T", "1/4.", "1/8." };
+    static constexpr double lfoDivisionBeats[numLfoDivisions] = { 16.0, 8.0, 4.0, 2.0, 1.0, 0.5, 0.25, 0.125,
+                                                                  2.0 / 3.0, 1.0 / 3.0, 1.0 / 6.0, 1.5, 0.75 };
+    void updateLfo();
+    //hands d (in samples) and exp of every channel for the next sub-block to the kernel, with the lfo applied
+    template <typename SampleType>
+    void updateChannelValues(float lfoDelayDepth, float lfoExpDepth);
+
+    //idle bypass: after the input has been silent for longer than the delay and the rms
+    //window reach back, the dsp would only output zeros (the rms sum stays below
+    //the kernel's silence threshold), so it gets skipped until the input comes back
+    template <typename SampleType>
+    bool checkIdle(const juce::AudioBuffer<SampleType>& buffer);
+    static constexpr float idleThreshold = 1.0e-4f; //-80dB, a full window of it (192kHz) is still below rmsSilenceThreshold
+    int idleAfterSamples = 0;
+    int silentSamples = 0;
+    bool idle = false;
+    int channelsToReset = 0; //of the kernel, going idle resets one per block
+
+    //metering: peaks are collected per sub-block, every meterFrameLength samples they go
+    //into the fifo as one frame together with the kernel's gain and soft attack count
+    MeterFifo meterFifo;
+    std::atomic<bool> meteringEnabled { false };
+    MeterFrame pendingMeterFrame;
+    int meterFrameLength = 441; //10ms, set in prepareToPlay
+    int meterFrameSamples = 0;
+    uint32_t lastNumSoftAttacks = 0;
+    template <typename SampleType>
+    static float getPeak(const SampleType* const* channels, int numChannels, int numSamples);
+    template <typename SampleType>
+    void advanceMeter(int numSamples);
+
+   #if SELFMULT_STAGE_TIMINGS
+    StageProfiler profiler;
+   #endif
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SelfMultAudioProcessor)
 };
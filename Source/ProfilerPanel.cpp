@@ -0,0 +1,94 @@
+/*
+  ==============================================================================
+
+    ProfilerPanel.cpp
+
+  ==============================================================================
+*/
+
+#include "ProfilerPanel.h"
+
+#if SELFMULT_STAGE_TIMINGS
+
+ProfilerPanel::ProfilerPanel (SelfMultAudioProcessor& p)
+    : audioProcessor (p)
+{
+    resetButton.onClick = [this] { audioProcessor.getProfiler().reset(); };
+    addAndMakeVisible (resetButton);
+
+    csvButton.onClick = [this] { saveCsv(); };
+    addAndMakeVisible (csvButton);
+
+    startTimerHz (4);
+}
+
+void ProfilerPanel::saveCsv()
+{
+    fileChooser = std::make_unique<juce::FileChooser> ("save profile", juce::File::getSpecialLocation (juce::File::userDocumentsDirectory)
+                                                                           .getChildFile ("SelfMultProfile.csv"), "*.csv");
+
+    fileChooser->launchAsync (juce::FileBrowserComponent::saveMode | juce::FileBrowserComponent::canSelectFiles
+                                | juce::FileBrowserComponent::warnAboutOverwriting,
+                              [this] (const juce::FileChooser& chooser)
+                              {
+                                  auto file = chooser.getResult();
+                                  if (file != juce::File())
+                                      audioProcessor.getProfiler().writeCsv (file);
+                              });
+}
+
+void ProfilerPanel::resized()
+{
+    auto buttons = getLocalBounds().removeFromTop (20).removeFromRight (150);
+    csvButton.setBounds (buttons.removeFromRight (75).reduced (2, 0));
+    resetButton.setBounds (buttons.reduced (2, 0));
+}
+
+void ProfilerPanel::paint (juce::Graphics& g)
+{
+    const auto& profiler = audioProcessor.getProfiler();
+
+    g.fillAll (juce::Colours::black.withAlpha (0.4f));
+    g.setColour (juce::Colours::lightgrey);
+    g.setFont (12.0f);
+
+    auto bounds = getLocalBounds().reduced (4, 2);
+    auto header = bounds.removeFromTop (18);
+    g.drawText ("load " + juce::String (profiler.getLoadPercentage(), 1) + "%   xruns " + juce::String (profiler.getNumXruns())
+                  + "   blocks " + juce::String (profiler.getNumBlocks()),
+                header, juce::Justification::centredLeft);
+
+    const int rowHeight = juce::jmin (20, bounds.getHeight() / (StageProfiler::numHistograms + 1));
+    auto columns = bounds.removeFromTop (rowHeight);
+    const int nameWidth = 80, valueWidth = 60;
+
+    auto drawColumns = [&] (juce::Rectangle<int> row, const juce::StringArray& texts)
+    {
+        g.drawText (texts[0], row.removeFromLeft (nameWidth), juce::Justification::centredLeft);
+        for (int i = 1; i < texts.size(); ++i)
+            g.drawText (texts[i], row.removeFromLeft (valueWidth), juce::Justification::centredRight);
+    };
+    drawColumns (columns, { "us/block", "mean", "p50", "p99", "max" });
+
+    auto us = [] (double ns) { return juce::String (ns / 1000.0, 1); };
+
+    for (int h = 0; h < StageProfiler::numHistograms; ++h)
+    {
+        auto row = bounds.removeFromTop (rowHeight);
+        drawColumns (row, { StageProfiler::getHistogramName (h), us (profiler.getMeanNs (h)), us ((double) profiler.getPercentileNs (h, 0.5)),
+                            us ((double) profiler.getPercentileNs (h, 0.99)), us ((double) profiler.getMaxNs (h)) });
+
+        //the histogram as bars, one per bucket, log scaled counts
+        auto bars = row.withTrimmedLeft (nameWidth + 4 * valueWidth + 8).reduced (0, 2).toFloat();
+        const float barWidth = bars.getWidth() / StageProfiler::numBuckets;
+        const float logMax = std::log1p ((float) juce::jmax (1u, profiler.getNumBlocks()));
+
+        for (int bucket = 0; bucket < StageProfiler::numBuckets; ++bucket)
+        {
+            const float height = bars.getHeight() * std::log1p ((float) profiler.getCount (h, bucket)) / logMax;
+            g.fillRect (bars.getX() + bucket * barWidth, bars.getBottom() - height, juce::jmax (1.0f, barWidth - 1.0f), height);
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,41 @@
+/*
+  ==============================================================================
+
+    ProfilerPanel.h
+    Debug panel for the StageProfiler: time per block of every stage (mean, p50,
+    p99, max and the histogram), cpu load and xruns, with a csv dump.
+    Only built with SELFMULT_STAGE_TIMINGS=1.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "PluginProcessor.h"
+
+#if SELFMULT_STAGE_TIMINGS
+
+class ProfilerPanel  : public juce::Component,
+                       private juce::Timer
+{
+public:
+    explicit ProfilerPanel (SelfMultAudioProcessor&);
+
+    void paint (juce::Graphics&) override;
+    void resized() override;
+
+private:
+    void timerCallback() override    { repaint(); }
+    void saveCsv();
+
+    SelfMultAudioProcessor& audioProcessor;
+
+    juce::TextButton resetButton { "reset" };
+    juce::TextButton csvButton { "save csv" };
+    std::unique_ptr<juce::FileChooser> fileChooser;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ProfilerPanel)
+};
+
+#endif
@@ -0,0 +1,150 @@
+/*
+  ==============================================================================
+
+    RealtimeCheck.cpp
+
+  ==============================================================================
+*/
+
+#include "RealtimeCheck.h"
+
+#if SELFMULT_REALTIME_CHECKS
+
+#include <cstdlib>
+#include <new>
+
+#if JUCE_LINUX
+ #include <dlfcn.h>
+ #include <pthread.h>
+#endif
+
+#if JUCE_WINDOWS
+ #include <malloc.h>
+#endif
+
+namespace
+{
+    thread_local bool onAudioThread = false;
+    std::atomic<int> numViolations { 0 };
+
+    void checkRealtime()
+    {
+        if (! onAudioThread)
+            return;
+
+        //off while reporting, the assertion itself may allocate
+        onAudioThread = false;
+        ++numViolations;
+        jassertfalse; //allocation or lock inside processBlock
+        onAudioThread = true;
+    }
+
+    void* allocate (std::size_t size)
+    {
+        checkRealtime();
+
+        if (void* p = std::malloc (size > 0 ? size : 1))
+            return p;
+
+        throw std::bad_alloc();
+    }
+
+    void release (void* p) noexcept
+    {
+        if (p != nullptr)
+            checkRealtime();
+
+        std::free (p);
+    }
+
+    void* allocateAligned (std::size_t size, std::align_val_t alignment)
+    {
+        checkRealtime();
+
+        const auto align = juce::jmax (static_cast<std::size_t> (alignment), sizeof (void*));
+       #if JUCE_WINDOWS
+        if (void* p = _aligned_malloc (size > 0 ? size : 1, align))
+            return p;
+       #else
+        void* p = nullptr;
+        if (posix_memalign (&p, align, size > 0 ? size : 1) == 0)
+            return p;
+       #endif
+
+        throw std::bad_alloc();
+    }
+
+    void releaseAligned (void* p) noexcept
+    {
+        if (p != nullptr)
+            checkRealtime();
+
+       #if JUCE_WINDOWS
+        _aligned_free (p);
+       #else
+        std::free (p);
+       #endif
+    }
+
+    template <typename Allocate>
+    void* allocateNoThrow (Allocate&& allocateFunction) noexcept
+    {
+        try { return allocateFunction(); }
+        catch (...) { return nullptr; }
+    }
+}
+
+namespace RealtimeCheck
+{
+    ScopedAudioThread::ScopedAudioThread() : wasActive (onAudioThread)   { onAudioThread = true; }
+    ScopedAudioThread::~ScopedAudioThread()                             { onAudioThread = wasActive; }
+
+    int getNumViolations()      { return numViolations.load(); }
+}
+
+void* operator new (std::size_t size)               { return allocate (size); }
+void* operator new[] (std::size_t size)             { return allocate (size); }
+void operator delete (void* p) noexcept             { release (p); }
+void operator delete[] (void* p) noexcept           { release (p); }
+void operator delete (void* p, std::size_t) noexcept    { release (p); }
+void operator delete[] (void* p, std::size_t) noexcept  { release (p); }
+
+void* operator new (std::size_t size, const std::nothrow_t&) noexcept      { return allocateNoThrow ([=] { return allocate (size); }); }
+void* operator new[] (std::size_t size, const std::nothrow_t&) noexcept    { return allocateNoThrow ([=] { return allocate (size); }); }
+void operator delete (void* p, const std::nothrow_t&) noexcept             { release (p); }
+void operator delete[] (void* p, const std::nothrow_t&) noexcept           { release (p); }
+
+void* operator new (std::size_t size, std::align_val_t alignment)          { return allocateAligned (size, alignment); }
+void* operator new[] (std::size_t size, std::align_val_t alignment)        { return allocateAligned (size, alignment); }
+void* operator new (std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept    { return allocateNoThrow ([=] { return allocateAligned (size, alignment); }); }
+void* operator new[] (std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept  { return allocateNoThrow ([=] { return allocateAligned (size, alignment); }); }
+void operator delete (void* p, std::align_val_t) noexcept                  { releaseAligned (p); }
+void operator delete[] (void* p, std::align_val_t) noexcept                { releaseAligned (p); }
+void operator delete (void* p, std::size_t, std::align_val_t) noexcept     { releaseAligned (p); }
+void operator delete[] (void* p, std::size_t, std::align_val_t) noexcept   { releaseAligned (p); }
+void operator delete (void* p, std::align_val_t, const std::nothrow_t&) noexcept    { releaseAligned (p); }
+void operator delete[] (void* p, std::align_val_t, const std::nothrow_t&) noexcept  { releaseAligned (p); }
+
+#if JUCE_LINUX
+//forwards to the real one, looked up on first use
+extern "C" int pthread_mutex_lock (pthread_mutex_t* mutex)
+{
+    using LockFunction = int (*) (pthread_mutex_t*);
+    static const auto realLock = reinterpret_cast<LockFunction> (dlsym (RTLD_NEXT, "pthread_mutex_lock"));
+
+    checkRealtime();
+    return realLock (mutex);
+}
+#endif
+
+#else
+
+namespace RealtimeCheck
+{
+    ScopedAudioThread::ScopedAudioThread() : wasActive (false) {}
+    ScopedAudioThread::~ScopedAudioThread() {}
+
+    int getNumViolations()      { return 0; }
+}
+
+#endif
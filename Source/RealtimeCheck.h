@@ -0,0 +1,45 @@
+/*
+  ==============================================================================
+
+    RealtimeCheck.h
+    Check that processBlock doesn't allocate or lock, for the tools that host
+    the processor themselves.
+
+    While a ScopedAudioThread is alive, every operator new/delete on that thread
+    (all the forms, aligned and nothrow too, and on linux every pthread_mutex_lock,
+    which juce::CriticalSection and std::mutex end up in) counts as a violation
+    and hits a jassert.
+    It replaces the global operators and pthread_mutex_lock, which inside a
+    plugin would reach into the host's process, so it's off unless
+    SELFMULT_REALTIME_CHECKS=1. The benchmark and the stress test set that.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+#ifndef SELFMULT_REALTIME_CHECKS
+ #define SELFMULT_REALTIME_CHECKS 0
+#endif
+
+namespace RealtimeCheck
+{
+    struct ScopedAudioThread
+    {
+        ScopedAudioThread();
+        ~ScopedAudioThread();
+
+        bool wasActive;
+    };
+
+    // number of allocations/locks seen inside a ScopedAudioThread since the start
+    int getNumViolations();
+}
+
+#if SELFMULT_REALTIME_CHECKS
+ #define SELFMULT_REALTIME_SCOPE RealtimeCheck::ScopedAudioThread realtimeScope
+#else
+ #define SELFMULT_REALTIME_SCOPE
+#endif
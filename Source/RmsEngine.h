@@ -0,0 +1,203 @@
+/*
+  ==============================================================================
+
+    RmsEngine.h
+    Sliding window sum of the squared input, per channel, computed a block at a time.
+    SampleType is float or double, the running sums are double either way.
+
+    The squares and their differences are plain loops over the whole block that
+    the compiler vectorizes, only the running sum itself is serial. It is kept
+    in double, and the squares of every pass through the window are summed as
+    they're written: when the write index wraps, that sum is the exact sum of the
+    window and replaces the running one, so it can't drift over long sessions
+    (and there's no block that has to re-sum whole windows at once). The serial
+    sums of a group of channels run side by side, so more channels cost less each.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+template <typename SampleType>
+class RmsEngine
+{
+public:
+    void prepare (int newNumChannels, int newWindowLength, int maxBlockSize)
+    {
+        numChannels = newNumChannels;
+        windowLength = std::max (newWindowLength, 1);
+
+        window.assign (static_cast<size_t> (numChannels * windowLength), SampleType (0));
+        deltas.assign (static_cast<size_t> (std::max (maxBlockSize, 1) * maxGroupSize), SampleType (0));
+        sums.assign (static_cast<size_t> (numChannels), 0.0);
+        lastSquares.assign (static_cast<size_t> (numChannels), SampleType (0));
+        writeIndices.assign (static_cast<size_t> (numChannels), 0);
+        passSums.assign (static_cast<size_t> (numChannels), 0.0);
+    }
+
+    void reset()
+    {
+        std::fill (window.begin(), window.end(), SampleType (0));
+        std::fill (sums.begin(), sums.end(), 0.0);
+        std::fill (lastSquares.begin(), lastSquares.end(), SampleType (0));
+        std::fill (writeIndices.begin(), writeIndices.end(), 0);
+        std::fill (passSums.begin(), passSums.end(), 0.0);
+    }
+
+    void resetChannel (int channel)
+    {
+        std::fill_n (window.begin() + channel * windowLength, windowLength, SampleType (0));
+        sums[static_cast<size_t> (channel)] = 0;
+        lastSquares[static_cast<size_t> (channel)] = SampleType (0);
+        writeIndices[static_cast<size_t> (channel)] = 0;
+        passSums[static_cast<size_t> (channel)] = 0;
+    }
+
+    int getWindowLength() const     { return windowLength; }
+
+    // window index the next sample of this channel gets written to
+    int getWriteIndex (int channel) const       { return writeIndices[static_cast<size_t> (channel)]; }
+
+    // sum * normalisation = (rms / rms of a full scale sine)^2
+    SampleType getNormalisation() const     { return SampleType (2) / static_cast<SampleType> (windowLength); }
+
+    // the running sums of up to this many channels are updated together
+    static constexpr int maxGroupSize = 8;
+
+    // pushes a block (at most maxBlockSize samples) of the channels firstChannel .. firstChannel + groupSize - 1,
+    // writes the window sum after every sample to rmsSums and the difference of every square to the one before it to rises
+    void process (int firstChannel, int groupSize, const SampleType* const* inputs, int numSamples,
+                  SampleType* const* rmsSums, SampleType* const* rises)
+    {
+        processImpl<false> (firstChannel, groupSize, inputs, numSamples, rmsSums, rises);
+    }
+
+    // same, but the inputs already are squares (the decimated envelope pushes means of squares)
+    void processSquares (int firstChannel, int groupSize, const SampleType* const* squares, int numSamples,
+                         SampleType* const* rmsSums, SampleType* const* rises)
+    {
+        processImpl<true> (firstChannel, groupSize, squares, numSamples, rmsSums, rises);
+    }
+
+    size_t getMemoryUsageInBytes() const
+    {
+        return sizeof (SampleType) * (window.size() + deltas.size() + lastSquares.size())
+             + sizeof (double) * (sums.size() + passSums.size()) + sizeof (int) * writeIndices.size();
+    }
+
+private:
+    template <bool inputIsSquared>
+    void processImpl (int firstChannel, int groupSize, const SampleType* const* inputs, int numSamples,
+                      SampleType* const* rmsSums, SampleType* const* rises)
+    {
+        //where the last pass through the window ended in this block (-1 if it didn't) and the window's sum there
+        int wrapIndices[maxGroupSize];
+        double wrapSums[maxGroupSize];
+
+        for (int g = 0; g < groupSize; g++)
+            pushSquares<inputIsSquared> (firstChannel + g, g, inputs[g], numSamples, rises[g], wrapIndices[g], wrapSums[g]);
+
+        //one add chain per channel, interleaved so the adds of different channels overlap
+        //instead of each sample waiting for the one before
+        double groupSums[maxGroupSize] = {};
+        for (int g = 0; g < groupSize; g++)
+            groupSums[g] = sums[static_cast<size_t> (firstChannel + g)];
+
+        for (int i = 0; i < numSamples; i++)
+        {
+            const SampleType* d = deltas.data() + i * maxGroupSize;
+
+            for (int g = 0; g < maxGroupSize; g++)
+                groupSums[g] += d[g];
+
+            for (int g = 0; g < groupSize; g++)
+                rmsSums[g][i] = static_cast<SampleType> (groupSums[g]);
+        }
+
+        for (int g = 0; g < groupSize; g++)
+        {
+            double& sum = sums[static_cast<size_t> (firstChannel + g)];
+            sum = groupSums[g];
+
+            //exact from the end of the pass on, plus what changed in the rest of the block
+            if (wrapIndices[g] >= 0)
+            {
+                sum = wrapSums[g];
+                for (int i = wrapIndices[g]; i < numSamples; i++)
+                    sum += deltas[static_cast<size_t> (i * maxGroupSize + g)];
+            }
+        }
+    }
+
+    // squares into the window, their differences to what they replace go to lane g of deltas
+    template <bool inputIsSquared>
+    void pushSquares (int channel, int g, const SampleType* input, int numSamples, SampleType* rises,
+                      int& wrapIndex, double& wrapSum)
+    {
+        SampleType* data = window.data() + channel * windowLength;
+        int& writeIndex = writeIndices[static_cast<size_t> (channel)];
+        SampleType& lastSquare = lastSquares[static_cast<size_t> (channel)];
+        double& passSum = passSums[static_cast<size_t> (channel)];
+        wrapIndex = -1;
+
+        for (int done = 0; done < numSamples;)
+        {
+            //contiguous part up to the end of the window
+            const int num = std::min (numSamples - done, windowLength - writeIndex);
+            const SampleType* in = input + done;
+            SampleType* squares = data + writeIndex;
+            SampleType* d = deltas.data() + done * maxGroupSize + g;
+
+            for (int i = 0; i < num; i++)
+            {
+                const SampleType square = inputIsSquared ? in[i] : in[i] * in[i];
+                d[i * maxGroupSize] = square - squares[i];
+                squares[i] = square;
+            }
+
+            rises[done] = squares[0] - lastSquare;
+            for (int i = 1; i < num; i++)
+                rises[done + i] = squares[i] - squares[i - 1];
+
+            lastSquare = squares[num - 1];
+            passSum += sumOf (squares, num);
+
+            done += num;
+            writeIndex += num;
+            if (writeIndex == windowLength)
+            {
+                writeIndex = 0;
+                wrapIndex = done;
+                wrapSum = passSum;
+                passSum = 0;
+            }
+        }
+    }
+
+    // four add chains, so summing the squares keeps up with writing them
+    static double sumOf (const SampleType* data, int num)
+    {
+        double partial[4] = {};
+        int i = 0;
+        for (; i + 4 <= num; i += 4)
+            for (int k = 0; k < 4; k++)
+                partial[k] += data[i + k];
+
+        for (; i < num; i++)
+            partial[0] += data[i];
+
+        return (partial[0] + partial[1]) + (partial[2] + partial[3]);
+    }
+
+    std::vector<SampleType> window;
+    std::vector<SampleType> deltas;
+    std::vector<double> sums;
+    std::vector<SampleType> lastSquares;
+    std::vector<int> writeIndices;
+    std::vector<double> passSums; //squares written since the write index last wrapped
+    int numChannels = 0;
+    int windowLength = 1;
+};
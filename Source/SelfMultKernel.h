@@ -0,0 +1,705 @@
+/*
+  ==============================================================================
+
+    SelfMultKernel.h
+    The whole SelfMult dsp (delay, rms envelope, soft attack and the multiply)
+    on plain channel pointers and without JUCE, so the same code can run in
+    offline tools or tests, not only inside the plugin.
+
+    Mode is a compile time policy for how the input and the delayed signal get
+    combined (see SelfMultMode), so another mode is another instantiation instead
+    of a branch in the hot loop. SampleType is float or double.
+
+    d and exp per channel and vol are set before each process() call, smoothing
+    and modulation are up to the caller (the processor does it per sub-block).
+    d and exp ramp to the new values over the call, so a value updated per
+    sub-block doesn't step.
+
+    The envelope (rms window and soft attack detection) can run decimated, on
+    the mean square of every envelopeDecimation samples, with the sums and soft
+    attack factors interpolated back to every sample. Its cost then stays that of
+    44.1/48 kHz at higher rates. It lags by envelopeDecimation samples and the
+    window sums between two envelope samples are a straight line, for a steady
+    signal of crest factor c that puts the window sum off by at most
+    2 * envelopeDecimation * c^2 / (window length in samples), relative, and the
+    gain by exp/2 times that: a sine at 192 kHz with 4x decimation is within 0.5%
+    (sum) and 0.75% (gain, exp 3).
+    That bound doesn't hold for transients. Soft attacks are detected on the
+    rises of the mean squares, and a rise shorter than envelopeDecimation samples
+    (a click, a step) is averaged into its group, so an attack can be missed or
+    found where the full rate one doesn't see one, not only moved by a few
+    samples. The gain is then off by up to the whole soft attack factor for as
+    long as the attack lasts. Measured against the full rate at 192 kHz (4x) and
+    384 kHz (8x): on drum like hits (0.5 ms attack, 50 ms decay) the same attacks
+    are found and 99% of the samples are within 1.3/2.5/3.8% (exp 1/2/3), but
+    right at the attacks it goes up to 0.4x/1x/2x. On the benchmark's transient
+    signal (clicks, dc steps) the attack counts differ by 5-25% and 17% (4x) to
+    40% (8x) of the samples are more than 10% off. Running the detection at the
+    full rate next to the decimated sums would cost about what the full rate
+    envelope does (the soft attack stage is most of it), so material like that
+    should use envelopeDecimation 1.
+
+    With an Oversampler set, only the multiply runs oversampled: the input and
+    the delayed signal go up, the gain (rms sums and soft attack factors, still
+    at the base rate) is held for every factor samples and delayed as much as
+    they are, and the product comes back down. The output is late by the
+    oversampler's latency then.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+#include "DelayLine.h"
+#include "ExponentPolicy.h"
+#include "MultiplyKernel.h"
+#include "Oversampler.h"
+#include "RmsEngine.h"
+#include "SlidingMaxTracker.h"
+#include "SoftAttackTable.h"
+#include "StageTimings.h"
+
+namespace SelfMultMode
+{
+    // the original mode: in * |delayed|^exp, negated if in*delayed < 0
+    struct A
+    {
+        // the simd functions in MultiplyKernel do exactly this
+        static constexpr bool hasMultiplyKernels = true;
+
+        template <typename Policy, typename T>
+        static T combine (T in, T delayed, T exponent)
+        {
+            const T powered = in * Policy::apply (std::abs (delayed), exponent);
+            return in * delayed < T (0) ? -powered : powered;
+        }
+    };
+}
+
+template <typename Mode, typename SampleType = float>
+class SelfMultKernel
+{
+public:
+    static_assert (std::is_floating_point<SampleType>::value, "SampleType has to be float or double");
+
+    using Interpolation = DelayInterpolation;
+    static constexpr int maxGroupSize = RmsEngine<SampleType>::maxGroupSize;
+
+    // allocates everything, process() may then be called with up to maxBlockSize samples.
+    // envelopeDecimation > 1 runs the envelope at sampleRate / envelopeDecimation (see above)
+    void prepare (double sampleRate, int newNumChannels, int maxDelayInSamples, int newMaxBlockSize, int newEnvelopeDecimation = 1)
+    {
+        numChannels = newNumChannels;
+        maxBlockSize = newMaxBlockSize;
+        envelopeDecimation = std::max (newEnvelopeDecimation, 1);
+        oversampler = nullptr; //might not fit anymore
+
+        delayLine.prepare (numChannels, maxDelayInSamples, maxBlockSize);
+        delayedBlock.assign (static_cast<size_t> (maxBlockSize), SampleType (0));
+
+        // at least 1 full wave while expecting 60Hz as lowest frequency, in envelope samples
+        const int windowLengthInSamples = static_cast<int> (std::ceil (1.0 / 60 * sampleRate));
+        windowLength = (windowLengthInSamples + envelopeDecimation - 1) / envelopeDecimation;
+
+        rmsSums.assign (static_cast<size_t> (maxGroupSize * maxBlockSize), SampleType (0));
+        rmsRises.assign (static_cast<size_t> (maxGroupSize * maxBlockSize), SampleType (0));
+
+        for (int g = 0; g < maxGroupSize; g++)
+        {
+            rmsSumPointers[g] = rmsSums.data() + g * maxBlockSize;
+            rmsRisePointers[g] = rmsRises.data() + g * maxBlockSize;
+        }
+
+        //the envelope samples completed in one block, and what's needed to interpolate between them
+        const int maxEnvelopeBlockSize = envelopeDecimation > 1 ? maxBlockSize / envelopeDecimation + 1 : 0;
+        rmsEngine.prepare (numChannels, windowLength, envelopeDecimation > 1 ? maxEnvelopeBlockSize : maxBlockSize);
+        envelopeSquares.assign (static_cast<size_t> (maxGroupSize * maxEnvelopeBlockSize), SampleType (0));
+        envelopeSums.assign (static_cast<size_t> (maxGroupSize * maxEnvelopeBlockSize), SampleType (0));
+        envelopeFactors.assign (static_cast<size_t> (maxGroupSize * maxEnvelopeBlockSize), SampleType (0));
+
+        for (int g = 0; g < maxGroupSize; g++)
+        {
+            envelopeSquarePointers[g] = envelopeSquares.data() + g * maxEnvelopeBlockSize;
+            envelopeSumPointers[g] = envelopeSums.data() + g * maxEnvelopeBlockSize;
+            envelopeFactorPointers[g] = envelopeFactors.data() + g * maxEnvelopeBlockSize;
+        }
+
+        const size_t numInterpolated = envelopeDecimation > 1 ? static_cast<size_t> (numChannels) : 0;
+        squareSums.assign (numInterpolated, SampleType (0));
+        sumsFrom.assign (numInterpolated, SampleType (0));
+        sumsTo.assign (numInterpolated, SampleType (0));
+        factorsFrom.assign (numInterpolated, SampleType (1));
+        factorsTo.assign (numInterpolated, SampleType (1));
+        envelopePhase = 0;
+
+        //the sums are of the mean squares, so they're envelopeDecimation times smaller for the same level
+        envelopeThreshold = static_cast<SampleType> (rmsSilenceThreshold) / static_cast<SampleType> (envelopeDecimation);
+
+        softAttackWindowLength = windowLength;
+        setSoftAttackWindow (nullptr);
+
+        softAttackProgress.assign (static_cast<size_t> (numChannels), 0);
+        softAttackMaxRise.assign (static_cast<size_t> (numChannels), SampleType (0));
+        softAttackMaxRiseIndex.assign (static_cast<size_t> (numChannels), 0);
+        softAttackInProgress.assign (static_cast<size_t> (numChannels), 0);
+
+        //rises in the window except the newest and the oldest, which both involve the sample being overwritten
+        softAttackRiseTrackers.resize (static_cast<size_t> (numChannels));
+        for (auto& tracker : softAttackRiseTrackers)
+            tracker.prepare (windowLength - 2);
+
+        channelExponents.assign (static_cast<size_t> (numChannels), 1.0f);
+        currentExponents = channelExponents;
+        lastRmsSums.assign (static_cast<size_t> (numChannels), SampleType (0));
+        lastSoftAttackFactors.assign (static_cast<size_t> (numChannels), SampleType (1));
+    }
+
+    // clears all signal history, the settings stay
+    void reset()
+    {
+        delayLine.reset();
+        rmsEngine.reset();
+
+        for (auto& tracker : softAttackRiseTrackers)
+            tracker.reset();
+
+        std::fill (softAttackMaxRise.begin(), softAttackMaxRise.end(), SampleType (0));
+        std::fill (softAttackMaxRiseIndex.begin(), softAttackMaxRiseIndex.end(), 0);
+        std::fill (softAttackInProgress.begin(), softAttackInProgress.end(), 0);
+        std::fill (softAttackProgress.begin(), softAttackProgress.end(), 0);
+        currentExponents = channelExponents;
+        std::fill (lastRmsSums.begin(), lastRmsSums.end(), SampleType (0));
+        std::fill (lastSoftAttackFactors.begin(), lastSoftAttackFactors.end(), SampleType (1));
+
+        std::fill (squareSums.begin(), squareSums.end(), SampleType (0));
+        std::fill (sumsFrom.begin(), sumsFrom.end(), SampleType (0));
+        std::fill (sumsTo.begin(), sumsTo.end(), SampleType (0));
+        std::fill (factorsFrom.begin(), factorsFrom.end(), SampleType (1));
+        std::fill (factorsTo.begin(), factorsTo.end(), SampleType (1));
+        envelopePhase = 0;
+
+        if (oversampler != nullptr)
+            oversampler->reset();
+    }
+
+    // reset() of a single channel, so a reset can be spread over several blocks. what all channels share
+    // (the delay line's write position, the envelope's decimation phase) stays, with every channel reset
+    // the output is the same as after reset() apart from where the decimated envelope's groups start
+    void resetChannel (int channel)
+    {
+        const auto c = static_cast<size_t> (channel);
+        delayLine.resetChannel (channel);
+        rmsEngine.resetChannel (channel);
+        softAttackRiseTrackers[c].reset();
+
+        softAttackMaxRise[c] = SampleType (0);
+        softAttackMaxRiseIndex[c] = 0;
+        softAttackInProgress[c] = 0;
+        softAttackProgress[c] = 0;
+        currentExponents[c] = channelExponents[c];
+        lastRmsSums[c] = SampleType (0);
+        lastSoftAttackFactors[c] = SampleType (1);
+
+        if (c < squareSums.size())
+        {
+            squareSums[c] = SampleType (0);
+            sumsFrom[c] = SampleType (0);
+            sumsTo[c] = SampleType (0);
+            factorsFrom[c] = SampleType (1);
+            factorsTo[c] = SampleType (1);
+        }
+
+        if (oversampler != nullptr)
+            oversampler->resetChannel (channel);
+    }
+
+    int getNumChannels() const      { return numChannels; }
+
+    // rms (and soft attack) window in envelope samples, what a SoftAttackTable has to be built for
+    int getWindowLength() const     { return windowLength; }
+    int getWindowLengthInSamples() const    { return windowLength * envelopeDecimation; }
+    int getEnvelopeDecimation() const       { return envelopeDecimation; }
+
+    void setInterpolation (Interpolation interpolation)     { delayLine.setInterpolation (interpolation); }
+
+    // d in samples, the delay line ramps to it over the next process() call
+    void setDelay (int channel, float delayInSamples)       { delayLine.setDelay (channel, delayInSamples); }
+
+    // the multiply ramps to it over the next process() call like d, once there it stays exactly on it,
+    // so 0, 0.5, 1 and 2 keep their fast paths. the soft attack uses it right away
+    void setExponent (int channel, float exponent)          { channelExponents[static_cast<size_t> (channel)] = exponent; }
+    void setUserVolume (float newUserVol)                   { userVol = newUserVol; }
+
+    // window^exp for the soft attack, used for the channels whose exp matches the table's, the grid
+    // interpolates for the others (nullptr for either computes it with pow).
+    // the kernel doesn't own them, they have to stay alive until replaced or the kernel prepared again
+    void setSoftAttackTable (const SoftAttackTable<SampleType>* newTable)             { softAttackTable = newTable; }
+    void setSoftAttackTableGrid (const SoftAttackTableGrid<SampleType>* newGrid)      { softAttackTableGrid = newGrid; }
+
+    // uses a soft attack window of getWindowLength() values from somewhere else (one shared by all the
+    // kernels at this rate) and frees its own, same lifetime rules. nullptr builds its own again, not realtime
+    void setSoftAttackWindow (const SampleType* sharedWindow)
+    {
+        if (sharedWindow != nullptr)
+        {
+            softAttackWindow = sharedWindow;
+            ownSoftAttackWindow = {};
+            return;
+        }
+
+        ownSoftAttackWindow.resize (static_cast<size_t> (softAttackWindowLength));
+        for (int i = 0; i < softAttackWindowLength; i++)
+            ownSoftAttackWindow[i] = SoftAttackTable<SampleType>::getWindow (i, softAttackWindowLength);
+        softAttackWindow = ownSoftAttackWindow.data();
+    }
+
+    // replaces the portable multiply stage with one of MultiplyKernel's functions (nullptr goes back)
+    void setMultiplyFunction (MultiplyKernel::ProcessFunction<SampleType> newFunction)
+    {
+        static_assert (Mode::hasMultiplyKernels, "the MultiplyKernel functions only do mode A");
+        multiplyFunction = newFunction;
+    }
+
+    MultiplyKernel::ProcessFunction<SampleType> getMultiplyFunction() const     { return multiplyFunction; }
+
+    // runs the multiply stage oversampled (see above), nullptr or a factor of 1 goes back to the base rate.
+    // it has to be prepared for this kernel's channels and at least its max block size, otherwise it's ignored.
+    // not owned, same lifetime rules as the soft attack tables
+    void setOversampler (Oversampler<SampleType>* newOversampler)
+    {
+        const bool fits = newOversampler != nullptr && newOversampler->getFactor() > 1
+                            && newOversampler->getNumChannels() == numChannels
+                            && newOversampler->getMaxBlockSize() >= maxBlockSize;
+        oversampler = fits ? newOversampler : nullptr;
+    }
+
+    // of the oversampling, the rest of the kernel doesn't add any
+    int getLatencyInSamples() const     { return oversampler != nullptr ? oversampler->getLatency() : 0; }
+
+    // processes numSamples (at most maxBlockSize) of every channel in place
+    void process (SampleType* const* channels, int numSamples)
+    {
+        //one group of channels at a time and every channel through all stages right away,
+        //so the few KB of scratch for a block stay in L1 instead of every stage sweeping all channels
+        for (int firstChannel = 0; firstChannel < numChannels; firstChannel += maxGroupSize)
+        {
+            int groupSize = std::min (maxGroupSize, numChannels - firstChannel);
+
+            calcRmsEnvelope (channels, firstChannel, groupSize, numSamples);
+
+            for (int g = 0; g < groupSize; g++)
+            {
+                int channel = firstChannel + g;
+
+                {
+                    SELFMULT_TIME_STAGE(stageTimings, delay);
+                    delayLine.write (channel, channels[channel], numSamples);
+                    delayLine.read (channel, delayedBlock.data(), numSamples);
+                }
+
+                //gain from the rms sums and the soft attack factors, and the multiply, in one pass
+                SELFMULT_TIME_STAGE(stageTimings, multiply);
+                if (oversampler != nullptr)
+                    multiplyOversampled (channels[channel], channel, g, numSamples);
+                else
+                    multiply (channels[channel], delayedBlock.data(), rmsSumPointers[g], rmsRisePointers[g], channel, numSamples);
+
+                currentExponents[static_cast<size_t> (channel)] = channelExponents[static_cast<size_t> (channel)];
+
+                //what getLastGain needs, the scratch gets overwritten by the next group
+                if (numSamples > 0)
+                {
+                    lastRmsSums[static_cast<size_t> (channel)] = rmsSumPointers[g][numSamples - 1];
+                    lastSoftAttackFactors[static_cast<size_t> (channel)] = rmsRisePointers[g][numSamples - 1];
+                }
+            }
+        }
+
+        delayLine.finishBlock (numSamples);
+        envelopePhase = (envelopePhase + numSamples) % envelopeDecimation;
+    }
+
+    // gain the rms compensation (and soft attack) applied at the last sample of the last process() call.
+    // one pow, meant for metering a few times per block at most
+    SampleType getLastGain (int channel) const
+    {
+        const SampleType sum = lastRmsSums[static_cast<size_t> (channel)];
+        if (sum < envelopeThreshold)
+            return 0;
+
+        const SampleType exponent = channelExponents[static_cast<size_t> (channel)];
+        return lastSoftAttackFactors[static_cast<size_t> (channel)] / std::pow (std::sqrt (sum * rmsEngine.getNormalisation()), exponent);
+    }
+
+    // counts up every time a soft attack starts on any channel (wraps around)
+    uint32_t getNumSoftAttacks() const      { return numSoftAttacks; }
+
+    // bytes allocated in prepare, without the object itself
+    size_t getMemoryUsageInBytes() const
+    {
+        size_t bytes = delayLine.getMemoryUsageInBytes() + rmsEngine.getMemoryUsageInBytes();
+        bytes += sizeof (SampleType) * (delayedBlock.size() + rmsSums.size() + rmsRises.size() + ownSoftAttackWindow.size()
+                                        + lastRmsSums.size() + lastSoftAttackFactors.size()
+                                        + envelopeSquares.size() + envelopeSums.size() + envelopeFactors.size()
+                                        + squareSums.size() + sumsFrom.size() + sumsTo.size() + factorsFrom.size() + factorsTo.size());
+
+        for (auto& tracker : softAttackRiseTrackers)
+            bytes += tracker.getMemoryUsageInBytes();
+
+        return bytes;
+    }
+
+   #if SELFMULT_STAGE_TIMINGS
+    StageTimings stageTimings;
+   #endif
+
+private:
+    void calcRmsEnvelope (const SampleType* const* input, int firstChannel, int groupSize, int numSamples)
+    {
+        if (envelopeDecimation > 1)
+        {
+            calcDecimatedEnvelope (input, firstChannel, groupSize, numSamples);
+            return;
+        }
+
+        //all channels are at the same position in their window
+        int startIndex = rmsEngine.getWriteIndex (firstChannel);
+
+        //squares, window sums and rises for the whole block and the group of channels at once
+        {
+            SELFMULT_TIME_STAGE(stageTimings, rms);
+            rmsEngine.process (firstChannel, groupSize, input + firstChannel, numSamples, rmsSumPointers, rmsRisePointers);
+        }
+
+        SELFMULT_TIME_STAGE(stageTimings, softAttack);
+        for (int g = 0; g < groupSize; g++)
+        {
+            //pow(x, exp) gets replaced by the exact cheap version when exp is 0, 0.5, 1 or 2
+            ExponentPolicy::dispatch (channelExponents[static_cast<size_t> (firstChannel + g)], [&] (auto policy) {
+                calcSoftAttackFactors<decltype (policy)> (firstChannel + g, rmsSumPointers[g], rmsRisePointers[g], startIndex, numSamples);
+            });
+        }
+    }
+
+    // the same on the mean squares of every envelopeDecimation samples, then back to every sample.
+    // soft attacks come from the rises of those means too, so on transients they can differ
+    // from the full rate ones (see the top of the file)
+    void calcDecimatedEnvelope (const SampleType* const* input, int firstChannel, int groupSize, int numSamples)
+    {
+        const int startIndex = rmsEngine.getWriteIndex (firstChannel);
+        const SampleType scale = SampleType (1) / static_cast<SampleType> (envelopeDecimation);
+        int numEnvelopeSamples = 0;
+
+        {
+            SELFMULT_TIME_STAGE(stageTimings, rms);
+            for (int g = 0; g < groupSize; g++)
+            {
+                const int channel = firstChannel + g;
+                const SampleType* x = input[channel];
+                SampleType* means = envelopeSquarePointers[g];
+                SampleType sum = squareSums[static_cast<size_t> (channel)];
+                int phase = envelopePhase;
+                int k = 0;
+
+                //group by group, the first one may have started in the block before
+                for (int i = 0; i < numSamples;)
+                {
+                    const int end = std::min (numSamples, i + envelopeDecimation - phase);
+                    phase += end - i;
+                    for (; i < end; i++)
+                        sum += x[i] * x[i];
+
+                    if (phase == envelopeDecimation)
+                    {
+                        means[k++] = sum * scale;
+                        sum = 0;
+                        phase = 0;
+                    }
+                }
+
+                squareSums[static_cast<size_t> (channel)] = sum;
+                numEnvelopeSamples = k; //same for every channel
+            }
+
+            rmsEngine.processSquares (firstChannel, groupSize, envelopeSquarePointers, numEnvelopeSamples,
+                                      envelopeSumPointers, envelopeFactorPointers);
+        }
+
+        {
+            SELFMULT_TIME_STAGE(stageTimings, softAttack);
+            for (int g = 0; g < groupSize; g++)
+            {
+                ExponentPolicy::dispatch (channelExponents[static_cast<size_t> (firstChannel + g)], [&] (auto policy) {
+                    calcSoftAttackFactors<decltype (policy)> (firstChannel + g, envelopeSumPointers[g], envelopeFactorPointers[g],
+                                                              startIndex, numEnvelopeSamples);
+                });
+            }
+        }
+
+        SELFMULT_TIME_STAGE(stageTimings, rms);
+        for (int g = 0; g < groupSize; g++)
+            interpolateEnvelope (firstChannel + g, g, numSamples);
+    }
+
+    // straight lines from one envelope sample to the next, one envelope sample behind as the line needs
+    // the point it's heading to. reaches a point at the last sample of the group after the one it was made of
+    void interpolateEnvelope (int channel, int groupIndex, int numSamples)
+    {
+        const size_t c = static_cast<size_t> (channel);
+        const SampleType* pointSums = envelopeSumPointers[groupIndex];
+        const SampleType* pointFactors = envelopeFactorPointers[groupIndex];
+        SampleType* sums = rmsSumPointers[groupIndex];
+        SampleType* factors = rmsRisePointers[groupIndex];
+
+        const SampleType step = SampleType (1) / static_cast<SampleType> (envelopeDecimation);
+        int phase = envelopePhase;
+        int k = 0;
+
+        for (int i = 0; i < numSamples;)
+        {
+            const int end = std::min (numSamples, i + envelopeDecimation - phase);
+            const SampleType sumFrom = sumsFrom[c], sumStep = (sumsTo[c] - sumFrom) * step;
+            const SampleType factorFrom = factorsFrom[c], factorStep = (factorsTo[c] - factorFrom) * step;
+
+            for (; i < end; i++)
+            {
+                const SampleType t = static_cast<SampleType> (++phase);
+                sums[i] = sumFrom + t * sumStep;
+                factors[i] = factorFrom + t * factorStep;
+            }
+
+            if (phase == envelopeDecimation)
+            {
+                sumsFrom[c] = sumsTo[c];
+                factorsFrom[c] = factorsTo[c];
+                sumsTo[c] = pointSums[k];
+                factorsTo[c] = pointFactors[k];
+                k++;
+                phase = 0;
+            }
+        }
+    }
+
+    template <typename Policy>
+    void calcSoftAttackFactors (int channel, const SampleType* sums, SampleType* rises, int rmsIndex, int numSamples)
+    {
+        const SampleType exponent = channelExponents[static_cast<size_t> (channel)];
+
+        //only the generic exponents have a pow to save. the table has to be for this exp and window length,
+        //otherwise it's interpolated from the grid (exact table: lower == upper and fraction 0)
+        SoftAttackLookup lookup;
+        if (std::is_same<Policy, ExponentPolicy::Generic>::value)
+        {
+            const float channelExponent = channelExponents[static_cast<size_t> (channel)];
+
+            if (softAttackTable != nullptr && softAttackTable->exponent == channelExponent
+                && static_cast<int> (softAttackTable->factors.size()) == softAttackWindowLength)
+            {
+                lookup.lower = lookup.upper = softAttackTable->factors.data();
+            }
+            else if (softAttackTableGrid != nullptr
+                     && softAttackTableGrid->windowLength == softAttackWindowLength)
+            {
+                if (!softAttackTableGrid->find (channelExponent, lookup.lower, lookup.upper, lookup.fraction))
+                    lookup.lower = nullptr;
+            }
+        }
+
+        //the soft attack has to go sample by sample, each rise gets replaced by the
+        //soft attack factor once it's used, the multiply stage reads those
+        for (int i = 0; i < numSamples; i++)
+        {
+            if (!softAttackInProgress[channel]) {
+                checkSoftAttackTrigger (channel, rises[i], rmsIndex, sums[i]);
+            }
+
+            //has to see every rise, also while a soft attack is running
+            softAttackRiseTrackers[channel].push (rises[i]);
+
+            rises[i] = getSoftAttackFactor<Policy> (channel, exponent, lookup);
+
+            if (++rmsIndex >= windowLength)
+            {
+                rmsIndex = 0;
+            }
+        }
+    }
+
+    struct SoftAttackLookup
+    {
+        const SampleType* lower = nullptr;
+        const SampleType* upper = nullptr;
+        SampleType fraction = 0;
+    };
+
+    template <typename Policy>
+    SampleType getSoftAttackFactor (int channel, SampleType exponent, const SoftAttackLookup& lookup)
+    {
+        if (softAttackProgress[channel] >= softAttackWindowLength-1) {
+            softAttackInProgress[channel] = 0;
+        }
+
+        if (!softAttackInProgress[channel])
+            return SampleType (1);
+
+        const int index = softAttackProgress[channel]++;
+        if (lookup.lower != nullptr)
+            return lookup.lower[index] + lookup.fraction * (lookup.upper[index] - lookup.lower[index]);
+
+        return Policy::apply (softAttackWindow[index], exponent);
+    }
+
+    void activateSoftAttack (int channel, SampleType rmsSum)
+    {
+        if (!softAttackInProgress[channel] && rmsSum > envelopeThreshold) {
+
+            softAttackInProgress[channel] = 1;
+            softAttackProgress[channel] = 0;
+            numSoftAttacks++;
+        }
+    }
+
+    void checkSoftAttackTrigger (int channel, SampleType diff, int rmsIndex, SampleType rmsSum)
+    {
+        //when maxRise got replaced by new sample find new maxRise, except new sample
+        //(the tracker covers the window without the new and the oldest rise, same as a full rescan would)
+        if (rmsIndex == softAttackMaxRiseIndex[channel])
+        {
+            softAttackMaxRise[channel] = softAttackRiseTrackers[channel].getMax();
+        }
+
+        //trigger if diff from new to last sample is 2x as max in window
+        if (softAttackMaxRise[channel] * 1.5 < diff) {
+            activateSoftAttack (channel, rmsSum);
+        }
+
+        if (softAttackMaxRise[channel] < diff) {
+            softAttackMaxRise[channel] = diff;
+            softAttackMaxRiseIndex[channel] = rmsIndex;
+        }
+    }
+
+    // exp goes from where the last block ended to the channel's exp, reached at the end of this one
+    void multiply (SampleType* channelData, const SampleType* delayed, const SampleType* sums,
+                   const SampleType* softAttackFactors, int channel, int numSamples)
+    {
+        const float exponent = currentExponents[static_cast<size_t> (channel)];
+        const float targetExponent = channelExponents[static_cast<size_t> (channel)];
+        const SampleType exponentStep = numSamples > 0 ? (static_cast<SampleType> (targetExponent) - static_cast<SampleType> (exponent))
+                                                           / static_cast<SampleType> (numSamples)
+                                                       : SampleType (0);
+
+        if constexpr (Mode::hasMultiplyKernels)
+        {
+            if (multiplyFunction != nullptr)
+            {
+                const MultiplyKernel::Settings<SampleType> settings { exponent, userVol, rmsEngine.getNormalisation(), envelopeThreshold, exponentStep };
+                multiplyFunction (channelData, delayed, sums, softAttackFactors, numSamples, settings);
+                return;
+            }
+        }
+
+        if (exponentStep != 0)
+        {
+            multiplyPortable<ExponentPolicy::Generic> (channelData, delayed, sums, softAttackFactors, static_cast<SampleType> (exponent), exponentStep, numSamples);
+            return;
+        }
+
+        ExponentPolicy::dispatch (exponent, [&] (auto policy) {
+            multiplyPortable<decltype (policy)> (channelData, delayed, sums, softAttackFactors, static_cast<SampleType> (exponent), SampleType (0), numSamples);
+        });
+    }
+
+    // the same multiply at factor times the rate, on the oversampler's buffers
+    void multiplyOversampled (SampleType* channelData, int channel, int groupIndex, int numSamples)
+    {
+        const int factor = oversampler->getFactor();
+        SampleType* input = oversampler->getBuffer (0);
+        SampleType* delayed = oversampler->getBuffer (1);
+        SampleType* sums = oversampler->getBuffer (2);
+        SampleType* softAttackFactors = oversampler->getBuffer (3);
+
+        oversampler->up (channel, 0, channelData, input, numSamples);
+        oversampler->up (channel, 1, delayedBlock.data(), delayed, numSamples);
+
+        oversampler->hold (channel, 0, rmsSumPointers[groupIndex], sums, numSamples);
+        oversampler->hold (channel, 1, rmsRisePointers[groupIndex], softAttackFactors, numSamples);
+
+        multiply (input, delayed, sums, softAttackFactors, channel, numSamples * factor);
+        oversampler->down (channel, input, channelData, numSamples);
+    }
+
+    // plain loop for any mode and sample type, std::pow for the generic exponents
+    template <typename Policy>
+    void multiplyPortable (SampleType* channelData, const SampleType* delayed, const SampleType* sums,
+                           const SampleType* softAttackFactors, SampleType firstExponent, SampleType exponentStep, int numSamples) const
+    {
+        const SampleType normalisation = rmsEngine.getNormalisation();
+        const SampleType volume = userVol;
+
+        for (int i = 0; i < numSamples; i++)
+        {
+            const SampleType exponent = firstExponent + static_cast<SampleType> (i) * exponentStep;
+
+            //too quiet gives 0 instead of a near inf factor
+            const SampleType gain = sums[i] < envelopeThreshold
+                                      ? SampleType (0)
+                                      : softAttackFactors[i] / Policy::apply (std::sqrt (sums[i] * normalisation), exponent);
+
+            channelData[i] = Mode::template combine<Policy> (channelData[i], delayed[i], exponent) * gain * volume;
+        }
+    }
+
+    static constexpr float rmsSilenceThreshold = 0.0001f;
+
+    int numChannels = 0;
+    int maxBlockSize = 0;
+
+    DelayLine<SampleType> delayLine;
+    std::vector<SampleType> delayedBlock; //one channel, reused for all
+
+    std::vector<float> channelExponents;
+    std::vector<float> currentExponents; //where the multiply's ramp is, the exp of the last block
+    float userVol = 1;
+    MultiplyKernel::ProcessFunction<SampleType> multiplyFunction = nullptr;
+    Oversampler<SampleType>* oversampler = nullptr;
+
+    RmsEngine<SampleType> rmsEngine;
+    std::vector<SampleType> rmsSums; //window sum after every sample, one row per channel of the current group
+    std::vector<SampleType> rmsRises; //overwritten with the soft attack factors
+    SampleType* rmsSumPointers[maxGroupSize] = {};
+    SampleType* rmsRisePointers[maxGroupSize] = {};
+    int windowLength = 1;
+
+    //decimated envelope: mean squares, their window sums and soft attack factors per envelope sample,
+    //the running sum of squares of the unfinished group and the ends of the line being interpolated
+    int envelopeDecimation = 1;
+    int envelopePhase = 0; //samples into the current group, the same for every channel
+    SampleType envelopeThreshold = static_cast<SampleType> (rmsSilenceThreshold);
+    std::vector<SampleType> envelopeSquares, envelopeSums, envelopeFactors;
+    SampleType* envelopeSquarePointers[maxGroupSize] = {};
+    SampleType* envelopeSumPointers[maxGroupSize] = {};
+    SampleType* envelopeFactorPointers[maxGroupSize] = {};
+    std::vector<SampleType> squareSums, sumsFrom, sumsTo, factorsFrom, factorsTo;
+
+    std::vector<SampleType> ownSoftAttackWindow;
+    const SampleType* softAttackWindow = nullptr; //the own one or a shared one
+    int softAttackWindowLength = 0;
+    const SoftAttackTable<SampleType>* softAttackTable = nullptr;
+    const SoftAttackTableGrid<SampleType>* softAttackTableGrid = nullptr;
+    std::vector<SampleType> softAttackMaxRise;
+    std::vector<int> softAttackMaxRiseIndex;
+    std::vector<SlidingMaxTracker<SampleType>> softAttackRiseTrackers;
+    std::vector<uint8_t> softAttackInProgress; //not vector<bool>, that one packs bits
+    std::vector<int> softAttackProgress;
+    uint32_t numSoftAttacks = 0;
+
+    std::vector<SampleType> lastRmsSums;
+    std::vector<SampleType> lastSoftAttackFactors;
+};
@@ -0,0 +1,117 @@
+/*
+  ==============================================================================
+
+    SharedTableCache.h
+    Read-only tables shared by every instance in the process: the soft attack
+    window, window^exp tables and the grid of them (see SoftAttackTable.h).
+
+    Get it through juce::SharedResourcePointer<SharedTableCache>. Tables are
+    keyed by window length (sample rate and envelope decimation) and exponent,
+    the cache only keeps weak references, so a table lives as long as one
+    instance uses it and the next instance at that rate gets the same copy.
+    Message thread (or any thread but the audio one), it locks.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <map>
+#include <memory>
+#include "SoftAttackTable.h"
+
+class SharedTableCache
+{
+public:
+    template <typename SampleType>
+    using Window = std::vector<SampleType>;
+
+    template <typename SampleType>
+    std::shared_ptr<const Window<SampleType>> getSoftAttackWindow (int windowLength)
+    {
+        return getOrCreate (getTables<SampleType>().windows, windowLength, [windowLength]
+        {
+            auto window = std::make_shared<Window<SampleType>> (static_cast<size_t> (windowLength));
+            for (int i = 0; i < windowLength; i++)
+                (*window)[static_cast<size_t> (i)] = SoftAttackTable<SampleType>::getWindow (i, windowLength);
+
+            return window;
+        });
+    }
+
+    template <typename SampleType>
+    std::shared_ptr<const SoftAttackTable<SampleType>> getSoftAttackTable (int windowLength, float exponent)
+    {
+        return getOrCreate (getTables<SampleType>().exponentTables, Key { windowLength, exponent }, [=]
+        {
+            return std::make_shared<SoftAttackTable<SampleType>> (windowLength, exponent);
+        });
+    }
+
+    template <typename SampleType>
+    std::shared_ptr<const SoftAttackTableGrid<SampleType>> getSoftAttackTableGrid (int windowLength, float maxExponent)
+    {
+        return getOrCreate (getTables<SampleType>().grids, Key { windowLength, maxExponent }, [=]
+        {
+            return std::make_shared<SoftAttackTableGrid<SampleType>> (windowLength, maxExponent);
+        });
+    }
+
+    // of the tables somebody still uses
+    size_t getMemoryUsageInBytes() const
+    {
+        const juce::ScopedLock sl (lock);
+        return floatTables.getMemoryUsageInBytes() + doubleTables.getMemoryUsageInBytes();
+    }
+
+private:
+    using Key = std::pair<int, float>;
+
+    template <typename SampleType>
+    struct Tables
+    {
+        std::map<int, std::weak_ptr<const Window<SampleType>>> windows;
+        std::map<Key, std::weak_ptr<const SoftAttackTable<SampleType>>> exponentTables;
+        std::map<Key, std::weak_ptr<const SoftAttackTableGrid<SampleType>>> grids;
+
+        size_t getMemoryUsageInBytes() const
+        {
+            size_t values = 0;
+            for (auto& entry : windows)         if (auto window = entry.second.lock()) values += window->size();
+            for (auto& entry : exponentTables)  if (auto table = entry.second.lock())  values += table->factors.size();
+            for (auto& entry : grids)           if (auto grid = entry.second.lock())   values += grid->factors.size();
+            return values * sizeof (SampleType);
+        }
+    };
+
+    template <typename SampleType>
+    Tables<SampleType>& getTables()
+    {
+        if constexpr (std::is_same<SampleType, double>::value)
+            return doubleTables;
+        else
+            return floatTables;
+    }
+
+    template <typename KeyType, typename Table, typename Create>
+    std::shared_ptr<const Table> getOrCreate (std::map<KeyType, std::weak_ptr<const Table>>& tables, const KeyType& key, Create&& create)
+    {
+        const juce::ScopedLock sl (lock);
+
+        if (auto existing = tables[key].lock())
+            return existing;
+
+        //the ones nobody uses anymore go while we're at it, built under the lock so there's only ever one
+        for (auto it = tables.begin(); it != tables.end();)
+            it = it->second.expired() && it->first != key ? tables.erase (it) : std::next (it);
+
+        std::shared_ptr<const Table> table = create();
+        tables[key] = table;
+        return table;
+    }
+
+    juce::CriticalSection lock;
+    Tables<float> floatTables;
+    Tables<double> doubleTables;
+};
@@ -0,0 +1,88 @@
+/*
+  ==============================================================================
+
+    SlidingMaxTracker.h
+    Maximum of the last n pushed values in amortized O(1), using a monotonic
+    deque stored in a ring that is allocated once in prepare().
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+template <typename SampleType>
+class SlidingMaxTracker
+{
+public:
+    // windowLength: how many of the last pushed values getMax() looks at
+    void prepare (int newWindowLength)
+    {
+        windowLength = newWindowLength > 0 ? static_cast<uint32_t> (newWindowLength) : 0;
+        capacity = static_cast<int> (windowLength) + 1;
+        entries.assign (static_cast<size_t> (capacity), {});
+        reset();
+    }
+
+    void reset()
+    {
+        head = 0;
+        numEntries = 0;
+        pushCount = 0;
+    }
+
+    void push (SampleType value)
+    {
+        //values that can't become the max anymore are dropped from the back
+        while (numEntries > 0 && back().value <= value)
+            numEntries--;
+
+        if (windowLength > 0)
+        {
+            entries[(head + numEntries) % capacity] = { value, pushCount };
+            numEntries++;
+        }
+
+        pushCount++;
+        dropExpired();
+    }
+
+    // max of the last windowLength pushed values, but never below 0 (not pushed values count as 0)
+    SampleType getMax() const
+    {
+        return numEntries > 0 && entries[head].value > 0 ? entries[head].value : SampleType (0);
+    }
+
+    size_t getMemoryUsageInBytes() const
+    {
+        return sizeof (Entry) * entries.size();
+    }
+
+private:
+    struct Entry
+    {
+        SampleType value = 0;
+        uint32_t pushIndex = 0; //wraps around, only differences are used
+    };
+
+    Entry& back() { return entries[(head + numEntries - 1) % capacity]; }
+
+    void dropExpired()
+    {
+        while (numEntries > 0 && pushCount - entries[head].pushIndex > windowLength)
+        {
+            head = (head + 1) % capacity;
+            numEntries--;
+        }
+    }
+
+    std::vector<Entry> entries;
+    int capacity = 1;
+    uint32_t windowLength = 0;
+    int head = 0;
+    int numEntries = 0;
+    uint32_t pushCount = 0;
+};
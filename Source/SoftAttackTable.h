@@ -0,0 +1,84 @@
+/*
+  ==============================================================================
+
+    SoftAttackTable.h
+    The soft attack window and window^exp for one exponent.
+
+    The kernel needs the window raised to the channel's exponent for every sample
+    of a soft attack, a pow per sample unless exp is 0, 0.5, 1 or 2. With a table
+    built for the current exponent (off the audio thread) that's a lookup.
+    SoftAttackTableGrid covers the exponents in between (while exp is smoothed or
+    modulated by the lfo) with tables at fixed steps to interpolate between.
+    No JUCE in here.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+template <typename SampleType>
+struct SoftAttackTable
+{
+    SoftAttackTable (int windowLength, float newExponent)
+        : exponent (newExponent), factors (static_cast<size_t> (windowLength))
+    {
+        for (int i = 0; i < windowLength; i++)
+            factors[static_cast<size_t> (i)] = std::pow (getWindow (i, windowLength), static_cast<SampleType> (exponent));
+    }
+
+    //a window i chose with start and end at 1 and rapid fall at beginning
+    static SampleType getWindow (int i, int windowLength)
+    {
+        SampleType softAttackNormalized = static_cast<SampleType> (i) / windowLength; //from 0 to 1
+        return static_cast<SampleType> (1 / (100 * softAttackNormalized + 1) + 0.9901 * softAttackNormalized * softAttackNormalized);
+    }
+
+    float exponent;
+    std::vector<SampleType> factors; //window^exponent
+};
+
+// window^exp for exp = 0, 1/8, 2/8 ... maxExponent, one row per exponent.
+// in between it's linear in exp, which is off by at most step^2/8 * ln(window)^2 (relative).
+// the window's minimum is about 0.084, so that's 1.2% at the bottom of the dip and less elsewhere
+template <typename SampleType>
+struct SoftAttackTableGrid
+{
+    static constexpr int stepsPerUnit = 8;
+
+    SoftAttackTableGrid (int newWindowLength, float newMaxExponent)
+        : windowLength (newWindowLength),
+          maxExponent (newMaxExponent),
+          numRows (std::max (static_cast<int> (std::ceil (newMaxExponent * stepsPerUnit)) + 1, 2)),
+          factors (static_cast<size_t> (numRows) * static_cast<size_t> (windowLength))
+    {
+        for (int row = 0; row < numRows; row++)
+        {
+            const SampleType exponent = static_cast<SampleType> (row) / stepsPerUnit;
+            for (int i = 0; i < windowLength; i++)
+                factors[static_cast<size_t> (row * windowLength + i)] = std::pow (SoftAttackTable<SampleType>::getWindow (i, windowLength), exponent);
+        }
+    }
+
+    // the two rows around exponent and how far it is from the lower one, false if it's outside the grid
+    bool find (float exponent, const SampleType*& lower, const SampleType*& upper, SampleType& fraction) const
+    {
+        if (!(exponent >= 0.0f && exponent <= maxExponent))
+            return false;
+
+        const float position = exponent * stepsPerUnit;
+        const int row = std::min (static_cast<int> (position), numRows - 2);
+        lower = factors.data() + static_cast<size_t> (row * windowLength);
+        upper = lower + windowLength;
+        fraction = static_cast<SampleType> (position - static_cast<float> (row));
+        return true;
+    }
+
+    int windowLength;
+    float maxExponent;
+    int numRows;
+    std::vector<SampleType> factors;
+};
@@ -0,0 +1,144 @@
+/*
+  ==============================================================================
+
+    StageProfiler.cpp
+
+  ==============================================================================
+*/
+
+#include "StageProfiler.h"
+
+#if SELFMULT_STAGE_TIMINGS
+
+const char* StageProfiler::getHistogramName (int histogram)
+{
+    return histogram == block ? "block" : StageTimings::getStageName (histogram);
+}
+
+void StageProfiler::prepare (double sampleRate, int maximumBlockSize)
+{
+    loadMeasurer.reset (sampleRate, maximumBlockSize);
+    reset();
+}
+
+void StageProfiler::reset()
+{
+    for (auto& histogram : counts)
+        for (auto& count : histogram)
+            count.store (0, std::memory_order_relaxed);
+
+    for (int h = 0; h < numHistograms; ++h)
+    {
+        totalNs[(size_t) h].store (0, std::memory_order_relaxed);
+        maxNs[(size_t) h].store (0, std::memory_order_relaxed);
+    }
+
+    numBlocks.store (0, std::memory_order_relaxed);
+}
+
+//==============================================================================
+StageProfiler::ScopedBlock::ScopedBlock (StageProfiler& p, const StageTimings& t, int numSamples)
+    : profiler (p), timings (t), start (StageTimings::Clock::now()), loadTimer (p.loadMeasurer, numSamples)
+{
+}
+
+StageProfiler::ScopedBlock::~ScopedBlock()
+{
+    const auto blockNs = std::chrono::duration_cast<std::chrono::nanoseconds> (StageTimings::Clock::now() - start).count();
+    profiler.addBlock (timings, (int64_t) blockNs);
+}
+
+void StageProfiler::addBlock (const StageTimings& timings, int64_t blockNs)
+{
+    for (int stage = 0; stage < StageTimings::numStages; ++stage)
+    {
+        //the totals only grow, unless someone reset them (or the kernel got replaced)
+        const int64_t ticks = timings.ticks[(size_t) stage];
+        const int64_t delta = ticks >= lastTicks[(size_t) stage] ? ticks - lastTicks[(size_t) stage] : ticks;
+        lastTicks[(size_t) stage] = ticks;
+
+        add (stage, std::chrono::duration_cast<std::chrono::nanoseconds> (StageTimings::Clock::duration (delta)).count());
+    }
+
+    add (block, blockNs);
+    numBlocks.fetch_add (1, std::memory_order_relaxed);
+}
+
+void StageProfiler::add (int histogram, int64_t ns)
+{
+    //highest set bit is the bucket
+    int bucket = 0;
+    for (auto rest = (uint64_t) juce::jmax ((int64_t) 1, ns); rest > 1 && bucket < numBuckets - 1; rest >>= 1)
+        ++bucket;
+
+    counts[(size_t) histogram][(size_t) bucket].fetch_add (1, std::memory_order_relaxed);
+    totalNs[(size_t) histogram].fetch_add (ns, std::memory_order_relaxed);
+
+    //single writer, so no compare and swap needed
+    if (ns > maxNs[(size_t) histogram].load (std::memory_order_relaxed))
+        maxNs[(size_t) histogram].store (ns, std::memory_order_relaxed);
+}
+
+//==============================================================================
+double StageProfiler::getMeanNs (int histogram) const
+{
+    const auto blocks = getNumBlocks();
+    return blocks > 0 ? (double) totalNs[(size_t) histogram].load (std::memory_order_relaxed) / blocks : 0.0;
+}
+
+int64_t StageProfiler::getPercentileNs (int histogram, double fraction) const
+{
+    uint64_t total = 0;
+    for (int bucket = 0; bucket < numBuckets; ++bucket)
+        total += getCount (histogram, bucket);
+
+    if (total == 0)
+        return 0;
+
+    const auto target = (uint64_t) std::ceil (fraction * (double) total);
+    uint64_t seen = 0;
+    for (int bucket = 0; bucket < numBuckets - 1; ++bucket)
+    {
+        seen += getCount (histogram, bucket);
+        if (seen >= target)
+            return getBucketEndNs (bucket);
+    }
+
+    //the last bucket has no upper edge, the slowest block is the best bound there is
+    return getMaxNs (histogram);
+}
+
+bool StageProfiler::writeCsv (const juce::File& file) const
+{
+    juce::String csv;
+
+    auto addRow = [&] (const juce::String& label, std::function<juce::String (int)> value)
+    {
+        csv << label;
+        for (int h = 0; h < numHistograms; ++h)
+            csv << "," << value (h);
+        csv << "\n";
+    };
+
+    addRow ("", [] (int h) { return juce::String (getHistogramName (h)); });
+    addRow ("blocks", [this] (int) { return juce::String (getNumBlocks()); });
+    addRow ("mean_ns", [this] (int h) { return juce::String (getMeanNs (h), 1); });
+    addRow ("p50_ns", [this] (int h) { return juce::String (getPercentileNs (h, 0.5)); });
+    addRow ("p99_ns", [this] (int h) { return juce::String (getPercentileNs (h, 0.99)); });
+    addRow ("max_ns", [this] (int h) { return juce::String (getMaxNs (h)); });
+
+    for (int bucket = 0; bucket < numBuckets; ++bucket)
+    {
+        const auto label = bucket == numBuckets - 1 ? ">=" + juce::String (getBucketStartNs (bucket)) + "ns"
+                                                    : juce::String (getBucketStartNs (bucket)) + "-" + juce::String (getBucketEndNs (bucket)) + "ns";
+        addRow (label, [this, bucket] (int h) { return juce::String (getCount (h, bucket)); });
+    }
+
+    //only meaningful for the whole block
+    addRow ("load_percent", [this] (int h) { return h == block ? juce::String (getLoadPercentage(), 2) : juce::String(); });
+    addRow ("xruns", [this] (int h) { return h == block ? juce::String (getNumXruns()) : juce::String(); });
+
+    return file.replaceWithText (csv);
+}
+
+#endif
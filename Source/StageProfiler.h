@@ -0,0 +1,87 @@
+/*
+  ==============================================================================
+
+    StageProfiler.h
+    Per block histograms of the time each stage of processBlock takes, plus
+    the realtime load from juce::AudioProcessLoadMeasurer.
+
+    Once per block the audio thread takes the difference of the kernel's
+    StageTimings totals and adds it to one histogram per stage (and one for the
+    whole block). Buckets are powers of two in ns, the counters are atomics with
+    a single writer, so the editor can read them any time without locks.
+
+    Like StageTimings it only exists with SELFMULT_STAGE_TIMINGS=1, otherwise
+    SELFMULT_PROFILE_BLOCK expands to nothing and the class isn't there.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "StageTimings.h"
+
+#if SELFMULT_STAGE_TIMINGS
+
+class StageProfiler
+{
+public:
+    static constexpr int block = StageTimings::numStages; //histogram of the whole processBlock
+    static constexpr int numHistograms = StageTimings::numStages + 1;
+    static constexpr int numBuckets = 24; //bucket b counts blocks of [2^b, 2^(b+1)) ns, the last one everything above 8ms
+
+    static const char* getHistogramName (int histogram);
+
+    void prepare (double sampleRate, int maximumBlockSize);
+
+    // clears the histograms, may be called from any thread (a block running at the same time might get lost)
+    void reset();
+
+    struct ScopedBlock
+    {
+        ScopedBlock (StageProfiler&, const StageTimings&, int numSamples);
+        ~ScopedBlock();
+
+        StageProfiler& profiler;
+        const StageTimings& timings;
+        StageTimings::Clock::time_point start;
+        juce::AudioProcessLoadMeasurer::ScopedTimer loadTimer;
+    };
+
+    uint32_t getCount (int histogram, int bucket) const  { return counts[(size_t) histogram][(size_t) bucket].load (std::memory_order_relaxed); }
+    uint32_t getNumBlocks() const                       { return numBlocks.load (std::memory_order_relaxed); }
+    double getMeanNs (int histogram) const;
+    int64_t getMaxNs (int histogram) const              { return maxNs[(size_t) histogram].load (std::memory_order_relaxed); }
+
+    // upper edge of the bucket the given fraction of blocks falls into, 0.99 gives the p99.
+    // in the last bucket (above 8ms) it's the max instead
+    int64_t getPercentileNs (int histogram, double fraction) const;
+
+    static int64_t getBucketStartNs (int bucket)        { return bucket == 0 ? 0 : (int64_t) 1 << bucket; }
+    static int64_t getBucketEndNs (int bucket)          { return (int64_t) 1 << (bucket + 1); }
+
+    double getLoadPercentage() const                    { return loadMeasurer.getLoadAsPercentage(); }
+    int getNumXruns() const                             { return loadMeasurer.getXRunCount(); }
+
+    // one column per histogram: block count, mean, max, p50/p99, then the buckets, then load and xruns
+    bool writeCsv (const juce::File& file) const;
+
+private:
+    void addBlock (const StageTimings& timings, int64_t blockNs);
+    void add (int histogram, int64_t ns);
+
+    std::array<std::array<std::atomic<uint32_t>, numBuckets>, numHistograms> counts {};
+    std::array<std::atomic<int64_t>, numHistograms> totalNs {};
+    std::array<std::atomic<int64_t>, numHistograms> maxNs {};
+    std::atomic<uint32_t> numBlocks { 0 };
+
+    //totals of the last block, audio thread only
+    std::array<int64_t, StageTimings::numStages> lastTicks {};
+
+    juce::AudioProcessLoadMeasurer loadMeasurer;
+};
+
+ #define SELFMULT_PROFILE_BLOCK(profiler, timings, numSamples) StageProfiler::ScopedBlock scopedProfilerBlock (profiler, timings, numSamples)
+#else
+ #define SELFMULT_PROFILE_BLOCK(profiler, timings, numSamples)
+#endif
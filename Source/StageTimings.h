@@ -0,0 +1,75 @@
+/*
+  ==============================================================================
+
+    StageTimings.h
+    Accumulates the time spent in each stage of processBlock.
+    Only compiled in with SELFMULT_STAGE_TIMINGS=1 (the benchmark and the plugin's Profile configuration set it),
+    otherwise SELFMULT_TIME_STAGE expands to nothing.
+    No JUCE in here, SelfMultKernel uses it. StageProfiler turns the totals
+    into per block histograms for the editor.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+
+#ifndef SELFMULT_STAGE_TIMINGS
+ #define SELFMULT_STAGE_TIMINGS 0
+#endif
+
+struct StageTimings
+{
+    enum Stage
+    {
+        rms = 0,
+        softAttack, //trigger check, rise tracking and the window factors
+        delay,
+        multiply,
+        numStages
+    };
+
+    static const char* getStageName (int stage)
+    {
+        switch (stage)
+        {
+            case rms:           return "rmsEnvelope";
+            case softAttack:    return "softAttack";
+            case delay:         return "delay";
+            case multiply:      return "multiply";
+            default:            return "unknown";
+        }
+    }
+
+    void reset()
+    {
+        ticks.fill (0);
+    }
+
+    double getSeconds (int stage) const
+    {
+        return std::chrono::duration<double> (Clock::duration (ticks[(size_t) stage])).count();
+    }
+
+    using Clock = std::chrono::steady_clock;
+    std::array<int64_t, numStages> ticks {};
+
+    struct ScopedStage
+    {
+        ScopedStage (StageTimings& t, Stage s) : timings (t), stage (s), start (Clock::now()) {}
+        ~ScopedStage() { timings.ticks[(size_t) stage] += (Clock::now() - start).count(); }
+
+        StageTimings& timings;
+        Stage stage;
+        Clock::time_point start;
+    };
+};
+
+#if SELFMULT_STAGE_TIMINGS
+ #define SELFMULT_TIME_STAGE(timings, stage) StageTimings::ScopedStage scopedStage_##stage (timings, StageTimings::stage)
+#else
+ #define SELFMULT_TIME_STAGE(timings, stage)
+#endif
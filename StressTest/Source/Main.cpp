@@ -0,0 +1,363 @@
+/*
+  ==============================================================================
+
+    Worst case latency stress test for SelfMultAudioProcessor.
+
+    Plays a badly behaved host: every configuration is a host behaviour and an
+    input signal, run for some seconds of audio. Every host callback (a period of
+    samples, maybe split into several processBlock calls) is timed against its
+    deadline, the period's length in realtime, and the results are printed as
+    JSON with the p50/p99/p99.9/max of that load.
+
+    usage: SelfMultStress [--hosts fixed,hostile] [--signals noise,clicks] [--seconds 5]
+                          [--budget 0.5] [--precisions 32,64] [--seed 1] [--output report.json]
+
+    hosts:
+      fixed             48kHz stereo, 512 sample callbacks
+      random-blocks     callbacks of 32 to 4096 samples (prepared for 512), split at random
+                        points down to single samples
+      rate-changes      re-prepares at 44.1 to 384kHz every 250ms
+      layout-changes    re-prepares with 1, 2, 6, 8 or 16 channels every 250ms
+      parameter-sweeps  parameters jump before every callback, a preset change every 250ms
+      hostile           all of the above
+
+    signals: noise, bursts (full scale with no attack, the silence in between sometimes
+    long enough to go idle), clicks, ramps (a new biggest rise every sample),
+    denormals (subnormal noise with a loud ms every 500ms), steps (dc jumps)
+
+    Fails (exit code 1) when any callback took more than --budget of its deadline,
+    or when anything allocated or locked inside processBlock. Prepares aren't timed,
+    the callback right after one is. There's no message loop, so tables only change
+    on presets and prepares, exp changes go through the grid in between.
+    Run it on a quiet machine, the os can preempt any single callback.
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "../../Source/PluginProcessor.h"
+
+//==============================================================================
+namespace
+{
+    const juce::StringArray hostNames { "fixed", "random-blocks", "rate-changes", "layout-changes", "parameter-sweeps", "hostile" };
+    const juce::StringArray signalNames { "noise", "bursts", "clicks", "ramps", "denormals", "steps" };
+
+    const double sampleRates[] = { 44100.0, 48000.0, 88200.0, 96000.0, 176400.0, 192000.0, 384000.0 };
+    const int channelCounts[] = { 1, 2, 6, 8, 16 };
+    const int periods[] = { 32, 64, 128, 256, 512, 1024, 2048, 4096 };
+    constexpr int maxChannels = 16;
+    constexpr int maxPeriod = 4096;
+    constexpr int preparedBlockSize = 512;
+    constexpr double changeInterval = 0.25;
+
+    struct Host
+    {
+        bool randomBlocks, rateChanges, layoutChanges, parameterSweeps;
+
+        static Host fromName (const juce::String& name)
+        {
+            const bool hostile = name == "hostile";
+            return { hostile || name == "random-blocks", hostile || name == "rate-changes",
+                     hostile || name == "layout-changes", hostile || name == "parameter-sweeps" };
+        }
+    };
+
+    template <typename Type, size_t size>
+    Type pick (juce::Random& random, const Type (&values)[size])
+    {
+        return values[random.nextInt ((int) size)];
+    }
+
+    juce::StringArray parseNames (const juce::ArgumentList& args, const juce::String& option, const juce::StringArray& known)
+    {
+        if (! args.containsOption (option))
+            return known;
+
+        juce::StringArray names;
+        for (auto& token : juce::StringArray::fromTokens (args.getValueForOption (option), ",", {}))
+            if (known.contains (token.trim()))
+                names.add (token.trim());
+
+        return names;
+    }
+
+    // adversarial input, a host period at a time. the channels get the same signal (odd ones inverted),
+    // so the transients and soft attacks of all of them land on the same sample
+    class SignalGenerator
+    {
+    public:
+        SignalGenerator (int newKind, juce::int64 seed) : kind (newKind), random (seed) {}
+
+        template <typename SampleType>
+        void fill (juce::AudioBuffer<SampleType>& buffer, int numChannels, int numSamples, double sampleRate)
+        {
+            auto* first = buffer.getWritePointer (0);
+            for (int i = 0; i < numSamples; ++i)
+                first[i] = static_cast<SampleType> (next (sampleRate));
+
+            for (int channel = 1; channel < numChannels; ++channel)
+            {
+                buffer.copyFrom (channel, 0, buffer, 0, 0, numSamples);
+                if (channel % 2 != 0)
+                    buffer.applyGain (channel, 0, numSamples, SampleType (-1));
+            }
+        }
+
+    private:
+        float next (double sampleRate)
+        {
+            const float noise = random.nextFloat() * 2.0f - 1.0f;
+
+            switch (kind)
+            {
+                case 1: //bursts
+                    if (--remaining <= 0)
+                    {
+                        on = ! on;
+                        remaining = 1 + random.nextInt (juce::jmax (1, (int) (sampleRate * (on ? 0.05 : 1.0))));
+                    }
+                    return on ? noise : 0.0f;
+
+                case 2: //clicks
+                    if (--remaining > 0)
+                        return 0.0f;
+                    remaining = 1 + random.nextInt (2000);
+                    return random.nextBool() ? 1.0f : -1.0f;
+
+                case 3: //ramps, squares rising faster every sample for 200ms, then a drop
+                    phase += 5.0 / sampleRate;
+                    if (phase >= 1.0)
+                    {
+                        phase -= 1.0;
+                        sign = -sign;
+                    }
+                    return sign * (float) (phase * phase);
+
+                case 4: //denormals
+                    phase += 1.0 / sampleRate;
+                    if (phase >= 0.5)
+                        phase -= 0.5;
+                    return phase < 0.001 ? noise : 1.0e-39f * noise;
+
+                case 5: //steps
+                    if (--remaining <= 0)
+                    {
+                        remaining = 1 + random.nextInt (5000);
+                        level = (float) (random.nextInt (3) - 1);
+                    }
+                    return level;
+
+                default: //noise
+                    return noise;
+            }
+        }
+
+        int kind;
+        juce::Random random;
+        int remaining = 0;
+        bool on = false;
+        double phase = 0;
+        float sign = 1.0f;
+        float level = 0;
+    };
+
+    // what a host does with automation on the audio thread: every parameter jumps now and then
+    void sweepParameters (SelfMultAudioProcessor& processor, juce::Random& random)
+    {
+        for (auto* parameter : processor.getParameters())
+            if (random.nextInt (8) == 0)
+                parameter->setValue (random.nextFloat());
+    }
+
+    double getPercentile (const std::vector<double>& sorted, double percentile)
+    {
+        if (sorted.empty())
+            return 0;
+
+        return sorted[juce::jmin (sorted.size() - 1, (size_t) (percentile * (double) sorted.size()))];
+    }
+
+    template <typename SampleType>
+    juce::var runConfig (const juce::String& hostName, const juce::String& signalName, double seconds, double budget, juce::int64 seed)
+    {
+        const Host host = Host::fromName (hostName);
+        juce::Random random (seed);
+        SignalGenerator generator (signalNames.indexOf (signalName), seed);
+
+        SelfMultAudioProcessor processor;
+        if (std::is_same<SampleType, double>::value)
+            processor.setProcessingPrecision (juce::AudioProcessor::doublePrecision);
+
+        double sampleRate = 48000.0;
+        int numChannels = 2;
+        int period = preparedBlockSize;
+        int numPrepares = 0;
+
+        auto prepare = [&]
+        {
+            processor.releaseResources();
+
+            juce::AudioProcessor::BusesLayout layout;
+            layout.inputBuses.add (juce::AudioChannelSet::canonicalChannelSet (numChannels));
+            layout.outputBuses.add (juce::AudioChannelSet::canonicalChannelSet (numChannels));
+            processor.setBusesLayout (layout);
+
+            processor.setRateAndBufferSizeDetails (sampleRate, preparedBlockSize);
+            processor.prepareToPlay (sampleRate, preparedBlockSize);
+            ++numPrepares;
+        };
+
+        prepare();
+
+        juce::AudioBuffer<SampleType> buffer (maxChannels, maxPeriod);
+        juce::MidiBuffer midi;
+        std::vector<int> splits;
+        std::vector<double> loads, micros;
+        double worstLoad = 0;
+        auto* worst = new juce::DynamicObject();
+        int numBlocks = 0;
+
+        const int violationsBefore = RealtimeCheck::getNumViolations();
+
+        for (double processed = 0, sinceChange = 0; processed < seconds; )
+        {
+            //the host changes its mind between callbacks
+            if (sinceChange >= changeInterval)
+            {
+                sinceChange = 0;
+
+                if (host.rateChanges)
+                    sampleRate = pick (random, sampleRates);
+                if (host.layoutChanges)
+                    numChannels = pick (random, channelCounts);
+                if (host.rateChanges || host.layoutChanges)
+                    prepare();
+                if (host.randomBlocks)
+                    period = pick (random, periods);
+                if (host.parameterSweeps)
+                    processor.setCurrentProgram (random.nextInt (processor.getNumPrograms()));
+            }
+
+            if (host.parameterSweeps)
+                sweepParameters (processor, random);
+
+            generator.fill (buffer, numChannels, period, sampleRate);
+
+            //some hosts split their buffer at automation points, down to single samples
+            splits.clear();
+            for (int pos = 0; pos < period;)
+            {
+                const int blockSize = host.randomBlocks ? juce::jmin (period - pos, 1 + random.nextInt (period)) : period;
+                splits.push_back (blockSize);
+                pos += blockSize;
+            }
+
+            const auto start = juce::Time::getHighResolutionTicks();
+
+            for (int pos = 0, split = 0; pos < period; pos += splits[(size_t) split++])
+            {
+                juce::AudioBuffer<SampleType> block (buffer.getArrayOfWritePointers(), numChannels, pos, splits[(size_t) split]);
+                processor.processBlock (block, midi);
+            }
+
+            const double elapsed = juce::Time::highResolutionTicksToSeconds (juce::Time::getHighResolutionTicks() - start);
+            const double deadline = period / sampleRate;
+            const double load = elapsed / deadline;
+
+            loads.push_back (load);
+            micros.push_back (elapsed * 1.0e6);
+            numBlocks += (int) splits.size();
+
+            if (load > worstLoad)
+            {
+                worstLoad = load;
+                worst->setProperty ("sampleRate", sampleRate);
+                worst->setProperty ("channels", numChannels);
+                worst->setProperty ("period", period);
+                worst->setProperty ("blocks", (int) splits.size());
+                worst->setProperty ("us", elapsed * 1.0e6);
+                worst->setProperty ("deadlineUs", deadline * 1.0e6);
+                worst->setProperty ("atSecond", processed);
+            }
+
+            processed += deadline;
+            sinceChange += deadline;
+        }
+
+        const int violations = RealtimeCheck::getNumViolations() - violationsBefore;
+        processor.releaseResources();
+
+        std::sort (loads.begin(), loads.end());
+        std::sort (micros.begin(), micros.end());
+
+        auto* result = new juce::DynamicObject();
+        result->setProperty ("host", hostName);
+        result->setProperty ("signal", signalName);
+        result->setProperty ("precision", (int) sizeof (SampleType) * 8);
+        result->setProperty ("callbacks", (int) loads.size());
+        result->setProperty ("blocks", numBlocks);
+        result->setProperty ("prepares", numPrepares);
+
+        //load is the callback's time over its deadline, us the plain time (of callbacks of any size)
+        for (auto percentile : { std::make_pair ("p50", 0.5), std::make_pair ("p99", 0.99), std::make_pair ("p999", 0.999) })
+        {
+            result->setProperty (juce::String (percentile.first) + "Load", getPercentile (loads, percentile.second));
+            result->setProperty (juce::String (percentile.first) + "Us", getPercentile (micros, percentile.second));
+        }
+
+        result->setProperty ("maxLoad", loads.empty() ? 0.0 : loads.back());
+        result->setProperty ("maxUs", micros.empty() ? 0.0 : micros.back());
+        result->setProperty ("worst", juce::var (worst));
+        result->setProperty ("realtimeViolations", violations);
+        result->setProperty ("passed", worstLoad <= budget && violations == 0);
+        return juce::var (result);
+    }
+}
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+    juce::ArgumentList args (argc, argv);
+
+    const auto hosts = parseNames (args, "--hosts", hostNames);
+    const auto signals = parseNames (args, "--signals", signalNames);
+
+    const double seconds = args.containsOption ("--seconds") ? args.getValueForOption ("--seconds").getDoubleValue() : 5.0;
+    const double budget = args.containsOption ("--budget") ? args.getValueForOption ("--budget").getDoubleValue() : 0.5;
+    const juce::int64 seed = args.containsOption ("--seed") ? args.getValueForOption ("--seed").getLargeIntValue() : 1;
+
+    juce::Array<int> precisions;
+    for (auto& token : juce::StringArray::fromTokens (args.containsOption ("--precisions") ? args.getValueForOption ("--precisions") : "32", ",", {}))
+        precisions.add (token.trim().getIntValue());
+
+    juce::Array<juce::var> results;
+    bool failed = false;
+
+    for (auto precision : precisions)
+        for (auto& host : hosts)
+            for (auto& signal : signals)
+            {
+                auto result = precision == 64 ? runConfig<double> (host, signal, seconds, budget, seed)
+                                              : runConfig<float> (host, signal, seconds, budget, seed);
+                failed = failed || ! (bool) result["passed"];
+                results.add (result);
+            }
+
+    auto* root = new juce::DynamicObject();
+    root->setProperty ("kernel", MultiplyKernel::getImplementationName (MultiplyKernel::getBestImplementation<float>()));
+    root->setProperty ("seconds", seconds);
+    root->setProperty ("budget", budget);
+    root->setProperty ("realtimeChecks", SELFMULT_REALTIME_CHECKS != 0);
+    root->setProperty ("results", results);
+
+    const auto json = juce::JSON::toString (juce::var (root));
+
+    if (args.containsOption ("--output"))
+        juce::File::getCurrentWorkingDirectory().getChildFile (args.getValueForOption ("--output")).replaceWithText (json);
+    else
+        std::cout << json << std::endl;
+
+    return failed ? 1 : 0;
+}